@@ -6,6 +6,10 @@
 #define SIMULATION_H_IMM_H
 
 #include "graph.h"
+#include "RRpool.h"
+#include "threadpool.h"
+#include "context.h"
+#include <set>
 
 /*!
  * @brief Some predefined mathematical functions.
@@ -33,29 +37,14 @@ public:
     }
 };
 
-///set of RI sets
-vector<vector<node>> RRI;
-
-///covered[u] marks which RI sets the node u is covered by
-vector<int64> covered[MAX_NODE_SIZE];
-///coveredNum[u] marks how many RI sets the node u is covered by
-int64 coveredNum[MAX_NODE_SIZE];
-
 /*!
- * @brief Empty the set R.
+ * @brief Empty the set R of the current context.
+ * @param n : number of nodes of the graph
  */
-void init_R() {
-    RRI.clear();
-    for (auto &i : covered) i.clear();
-    memset(coveredNum, 0, sizeof(coveredNum));
+void init_R(node n) {
+    ctx().R.init(n);
 }
 
-///@brief temporary array for RI_Gen
-///
-/// no need to initialize
-int64 dist[MAX_NODE_SIZE + 1];
-bool DijkstraVis[MAX_NODE_SIZE];
-
 /*!
  * @brief Algorithm for CTIC to generate Reserve-Influence or Forward-Influence set of IMM.
  * @param graph : the graph
@@ -65,44 +54,18 @@ bool DijkstraVis[MAX_NODE_SIZE];
  *
  */
 void RI_Gen(Graph &graph, vector<node> &uStart, vector<node> &RR, bool RI_flag) {
-    if (dist[MAX_NODE_SIZE] != -1) {
-        //Initialize dist[] to be all -1 at the first time
-        memset(dist, -1, sizeof(dist));
-    }
-    auto *edge_list = RI_flag ? &graph.gT : &graph.g;
-    for (node u : uStart)
-        dist[u] = 0;
-    RR.clear();
-    priority_queue<pair<int64, node>> Q;
-    for (node u : uStart)
-        Q.push(make_pair(0, u));
-    while (!Q.empty()) { //Dijkstra Algorithm
-        node u = Q.top().second;
-        Q.pop();
-        if (DijkstraVis[u]) continue;
-        DijkstraVis[u] = true;
-        RR.emplace_back(u);
-        for (auto &edgeT : (*edge_list)[u]) {
-            bool activate_success = (random_real() < edgeT.p);
-            if (activate_success) {
-                int randomWeight;
-                if (graph.diff_model == IC) {
-                    randomWeight = 1;
-                } else if (graph.diff_model == IC_M) {
-                    geometric_distribution<int> distribution(edgeT.m);
-                    randomWeight = distribution(random_engine) + 1;
-                }
-                if ((dist[edgeT.v] == -1 || dist[edgeT.v] > dist[u] + randomWeight) &&
-                    dist[u] + randomWeight <= graph.deadline) {
-                    dist[edgeT.v] = dist[u] + randomWeight;
-                    Q.push(make_pair(-dist[edgeT.v], edgeT.v));
-                }
-            }
+    Context &c = ctx();
+    c.ws.resize(graph.n);
+    RI_Gen_kernel(graph, uStart, RR, RI_flag, c.ws.dist, c.ws.vis, c.engine);
+}
 
-        }
-    }
-    for (node u : RR)
-        dist[u] = -1, DijkstraVis[u] = false;
+/*!
+ * @brief insert a generated RI set into R.
+ * @param RR : the RI set
+ * @param state : the state of the random engine it is sampled from
+ */
+void push_R(vector<node> &RR, const std::minstd_rand &state) {
+    ctx().R.push(RR, state);
 }
 
 /*!
@@ -110,44 +73,55 @@ void RI_Gen(Graph &graph, vector<node> &uStart, vector<node> &RR, bool RI_flag)
  * @param G : the graph
  */
 void insert_R(Graph &G) {
+    Context &c = ctx();
     vector<node> RR;
-    uniform_int_distribution<node> uniformIntDistribution(0, G.n - 1);
-    vector<node> vStart = {uniformIntDistribution(random_engine)};
-    RI_Gen(G, vStart, RR, true);
-    RRI.emplace_back(RR);
-    for (node u : RR) {
-        covered[u].emplace_back(RR.size() - 1);
-        coveredNum[u]++;
-    }
+    std::minstd_rand state = c.engine;
+    c.ws.resize(G.n);
+    RI_sample(G, c.engine, RR, c.ws);
+    c.R.push(RR, state);
+}
+
+/*!
+ * @brief generate random RI sets into R until there are at least `num` of them.
+ * @param G : the graph
+ * @param num : the required size
+ */
+void fill_R(Graph &G, int64 num) {
+    phase_timer timer(PHASE_RR_SAMPLING);
+    RRcollection &R = ctx().R;
+    auto before = (int64) R.sets.size();
+    while (R.sets.size() < num)
+        insert_R(G);
+    profile_count(COUNTER_RR_SETS, (int64) R.sets.size() - before);
 }
 
 /*!
  * @brief generate FI sketches to evaluate the influence spread.
+ *
+ * The sketches are generated on the thread pool, each thread with its own temporary arrays and random stream.
  * @param graph : the graph that define propagation models(IC-M)
  * @param S : the seed set
  * @return the estimated value of influence spread
  */
 double FI_simulation(Graph &graph, vector<node> &S) {
-    vector<node> RR;
-    double res = 0, cur = clock();
-    for (int i = 1; i <= MC_iteration_rounds; i++) {
-        RI_Gen(graph, S, RR, false);
-        res += (double) RR.size() / MC_iteration_rounds;
-    }
+    double res = 0, cur = wall_clock();
+    ThreadPool &pool = thread_pool();
+    int64 chunks = min(MC_iteration_rounds, (int64) pool.size() * 4);
+    vector<int64> partial(chunks, 0);
+    pool.parallel_for(chunks, [&](int32 tid, int64 c) {
+        RI_workspace &ws = thread_workspace();
+        ws.resize(graph.n);
+        vector<node> RR;
+        for (int64 i = MC_iteration_rounds * c / chunks; i < MC_iteration_rounds * (c + 1) / chunks; i++) {
+            RI_Gen_kernel(graph, S, RR, false, ws.dist, ws.vis, ws.engine);
+            partial[c] += RR.size();
+        }
+    });
+    for (int64 c = 0; c < chunks; c++) res += (double) partial[c] / MC_iteration_rounds;
     if (verbose_flag) printf("\t\tresult=%.3f time=%.3f\n", res, time_by(cur));
     return res;
 }
 
-/*!
- * @brief temporary array for IMM_NodeSelection
- *
- * RIsetCovered : marking the RI sets that has been covered by S
- * nodeRemain : check if an node is remained in the heap
- * covered_num_tmp : a copy of covered_num
- */
-bool nodeRemain[MAX_NODE_SIZE];
-int64 coveredNum_tmp[MAX_NODE_SIZE];
-
 /*!
  * @brief Selection phase of IMM : Select a set S of size k that covers the maximum RI sets in R
  * @param graph : the graph
@@ -157,12 +131,19 @@ int64 coveredNum_tmp[MAX_NODE_SIZE];
  * @return : the fraction of RI sets in R that are covered by S
  */
 double IMMNodeSelection(Graph &graph, vector<node> &candidate, int32 k, vector<node> &S) {
+    phase_timer timer(PHASE_NODE_SELECTION);
     S.clear();
-    vector<bool> RIsetCovered(RRI.size(), false);
+    Context &c = ctx();
+    c.fit(graph);
+    RRcollection &R = c.R;
+    vector<bool> &nodeRemain = c.nodeRemain;
+    vector<int64> &coveredNum_tmp = c.coveredNum_tmp;
+    vector<bool> RIsetCovered(R.sets.size(), false);
     for (node i : candidate) nodeRemain[i] = true;
-    memcpy(coveredNum_tmp, coveredNum, graph.n * sizeof(int64));
+    copy(R.coveredNum.begin(), R.coveredNum.end(), coveredNum_tmp.begin());
     priority_queue<pair<int64, node>> Q;
     for (node i : candidate) Q.push(make_pair(coveredNum_tmp[i], i));
+    profile_count(COUNTER_HEAP_PUSHES, (int64) Q.size());
     int64 influence = 0;
 
     while (S.size() < k && !Q.empty()) {
@@ -171,21 +152,22 @@ double IMMNodeSelection(Graph &graph, vector<node> &candidate, int32 k, vector<n
         Q.pop();
         if (value > coveredNum_tmp[maxInd]) {
             Q.push(make_pair(coveredNum_tmp[maxInd], maxInd));
+            profile_count(COUNTER_HEAP_PUSHES);
             continue;
         }
         influence += coveredNum_tmp[maxInd];
         S.emplace_back(maxInd);
         nodeRemain[maxInd] = false;
-        for (int64 RIIndex : covered[maxInd]) {
+        for (int64 RIIndex : R.covered[maxInd]) {
             if (RIsetCovered[RIIndex]) continue;
-            for (node u : RRI[RIIndex]) {
+            for (node u : R.sets[RIIndex]) {
                 if (nodeRemain[u]) coveredNum_tmp[u]--;
             }
             RIsetCovered[RIIndex] = true;
         }
     }
     for (node i : candidate) nodeRemain[i] = false;
-    return (double) influence / RRI.size();
+    return (double) influence / R.sets.size();
 }
 
 /*!
@@ -197,6 +179,7 @@ double IMMNodeSelection(Graph &graph, vector<node> &candidate, int32 k, vector<n
  * @param iota : argument related to accuracy.
  */
 void IMMSampling(Graph &graph, vector<node> &candidate, int32 k, double eps, double iota) {
+    ctx().fit(graph);
     double epsilon_prime = eps * sqrt(2);
     double LB = 1;
     vector<node> S_tmp;
@@ -206,8 +189,7 @@ void IMMSampling(Graph &graph, vector<node> &candidate, int32 k, double eps, dou
                            (iota * log(graph.n) + Math::logcnk(graph.n, k) + log(Math::log2(graph.n))) / Math::sqr(epsilon_prime) *
                            pow(2.0, i));
         if(ci > (int64)100000000) break;
-        while (RRI.size() < ci)
-            insert_R(graph);
+        fill_R(graph, ci);
 
         double ept = IMMNodeSelection(graph, candidate, k, S_tmp);
         if (ept > 1.0 / pow(2.0, i)) {
@@ -220,13 +202,69 @@ void IMMSampling(Graph &graph, vector<node> &candidate, int32 k, double eps, dou
     double beta = sqrt((1.0 - 1.0 / e) * (Math::logcnk(graph.n, k) + iota * log(graph.n) + log(2)));
     auto C = (int64) (2.0 * graph.n * Math::sqr((1.0 - 1.0 / e) * alpha + beta) / LB / Math::sqr(eps));
     C = min(C, (int64)100000000);
-    while (RRI.size() < C)
-        insert_R(graph);
+    fill_R(graph, C);
     if (verbose_flag) {
         cout << "\tfinal C = " << C << endl;
     }
 }
 
+/*!
+ * @brief Pipelined sampling phase of IMM : sampler threads keep filling R while the lower bound is estimated.
+ *
+ * While node selection runs on the first c_i RI sets, samplers already produce the sets of the next
+ * iteration. Once LB is known the target is finalised to C, so the wall-clock time approaches that of
+ * sampling alone.
+ * @param graph : the graph
+ * @param kC : the size used in logcnk(n, kC)
+ * @param eps : argument related to accuracy.
+ * @param iota : argument related to accuracy.
+ * @param max_C : upper limit of the number of RI sets
+ * @param selection : node selection on R, returns the fraction of RI sets in R that are covered
+ */
+template<class Selection>
+void IMMSampling_pipelined(Graph &graph, int32 kC, double eps, double iota, int64 max_C, Selection selection) {
+    double epsilon_prime = eps * sqrt(2);
+    double LB = 1;
+    Context &c = ctx();
+    c.fit(graph);
+    auto base = (int64) c.R.sets.size();
+    RRpool pool(graph, c.pool().size(), max_C, c.sampler_workspaces);
+    auto insert = [&](vector<node> &RR, const std::minstd_rand &state) { c.R.push(RR, state); };
+    auto End = (int) (log2(graph.n) + 1e-9 - 1);
+    for (int i = 1; i <= End; i++) {
+        auto ci = (int64) ((2.0 + 2.0 / 3.0 * epsilon_prime) *
+                           (iota * log(graph.n) + Math::logcnk(graph.n, kC) + log(Math::log2(graph.n))) *
+                           pow(2.0, i) / Math::sqr(epsilon_prime));
+        if (ci > max_C) break;
+        //sample ahead for the next iteration while selecting on the current one
+        pool.set_target(min(2 * ci, max_C) - base);
+        {
+            //the time that node selection waits for the samplers
+            phase_timer timer(PHASE_RR_SAMPLING);
+            if (!pool.consume(ci - base, insert)) break;
+        }
+
+        double ept = selection();
+        if (ept > 1.0 / pow(2.0, i)) {
+            LB = ept * graph.n / (1.0 + epsilon_prime);
+            break;
+        }
+    }
+    double e = exp(1);
+    double alpha = sqrt(iota * log(graph.n) + log(2));
+    double beta = sqrt((1.0 - 1.0 / e) * (Math::logcnk(graph.n, kC) + iota * log(graph.n) + log(2)));
+    auto C = (int64) (2.0 * graph.n * Math::sqr((1.0 - 1.0 / e) * alpha + beta) / LB / Math::sqr(eps));
+    C = min(C, max_C);
+    {
+        phase_timer timer(PHASE_RR_SAMPLING);
+        pool.consume(C - base, insert);
+        pool.stop(insert);
+    }
+    if (verbose_flag) {
+        cout << "\tfinal C = " << C << " sampled = " << pool.merged << endl;
+    }
+}
+
 /*!
  * @brief Sampling phase of IMM : generate sufficient RI sets.
  * @param graph : the graph
@@ -239,9 +277,13 @@ void IMMSampling(Graph &graph, vector<node> &candidate, int32 k, double eps, dou
 void IMM(Graph &G, vector<node> &candidate, int32 k, double eps, double iota, vector<node> &S) {
     //init_R();
     double iota_new = iota * (1.0 + log(2) / log(G.n));
-//    while (RRI.size() < 200000)
+//    while (R.sets.size() < 200000)
 //        insert_R(G);
-    IMMSampling(G, candidate, k, eps, iota_new);
+    if (pipeline_flag) {
+        vector<node> S_tmp;
+        IMMSampling_pipelined(G, k, eps, iota_new, 100000000,
+                              [&]() { return IMMNodeSelection(G, candidate, k, S_tmp); });
+    } else IMMSampling(G, candidate, k, eps, iota_new);
     IMMNodeSelection(G, candidate, k, S);
 }
 
@@ -253,15 +295,11 @@ void IMM(Graph &G, vector<node> &candidate, int32 k, double eps, double iota, ve
  * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
  */
 void IMM_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
-    double cur = clock();
+    double cur = wall_clock();
+    ParticipantIndex &index = participant_index(graph, A);
     set<node> seeds_reorder;
-    for (node u : A) {
-        vector<node> neighbours, one_seed;
-        for (auto &edge : graph.g[u]) {
-            if (find(A.begin(), A.end(), edge.v) == A.end()) {
-                neighbours.emplace_back(edge.v);
-            }
-        }
+    for (int64 j = 0; j < A.size(); j++) {
+        vector<node> neighbours(index.neighbours(j).begin(), index.neighbours(j).end()), one_seed;
         IMM(graph, neighbours, k, 0.5, 1, one_seed);
         for (node w : one_seed)
             seeds_reorder.insert(w);
@@ -281,27 +319,22 @@ void IMM_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
  * @return : the fraction of RI sets in R that are covered by S
  */
 double IMMNodeSelection_advanced(Graph &graph, vector<node> &A, int32 k, vector<node> &S) {
+    phase_timer timer(PHASE_NODE_SELECTION);
     S.clear();
-    set<node> N; //candidate neighbour set
-    auto *num_neighbours = new node[graph.n]();
-    auto *f = new vector<node>[graph.n](); //f[v] means in-coming active participant of v
-    //push all candidate neighbour to S, and update f
-    for (node u : A) {
-        for (auto &edge : graph.g[u]) {
-            if (find(A.begin(), A.end(), edge.v) == A.end()) {
-                N.insert(edge.v);
-                f[edge.v].emplace_back(u);
-            }
-        }
-    }
-    for (node w : S) {
-        shuffle(f[w].begin(), f[w].end(), std::mt19937(std::random_device()()));
-    }
-    vector<bool> RIsetCovered(RRI.size(), false);
+    ParticipantIndex &index = participant_index(graph, A);
+    ParticipantQuota quota(index, k);
+    vector<node> &N = index.candidates; //candidate neighbour set
+    Context &c = ctx();
+    c.fit(graph);
+    RRcollection &R = c.R;
+    vector<bool> &nodeRemain = c.nodeRemain;
+    vector<int64> &coveredNum_tmp = c.coveredNum_tmp;
+    vector<bool> RIsetCovered(R.sets.size(), false);
     for (node i : N) nodeRemain[i] = true;
-    memcpy(coveredNum_tmp, coveredNum, graph.n * sizeof(int64));
+    copy(R.coveredNum.begin(), R.coveredNum.end(), coveredNum_tmp.begin());
     priority_queue<pair<int64, node>> Q;
     for (node i : N) Q.push(make_pair(coveredNum_tmp[i], i));
+    profile_count(COUNTER_HEAP_PUSHES, (int64) Q.size());
     int64 influence = 0;
 
     while (!Q.empty()) {
@@ -309,29 +342,27 @@ double IMMNodeSelection_advanced(Graph &graph, vector<node> &A, int32 k, vector<
         node maxInd = Q.top().second;
         Q.pop();
 
-        node u0 = source_participant(maxInd, f, k, num_neighbours);
-        if (u0 == -1) continue;
+        if (!quota.available(maxInd)) continue;
 
         if (value > coveredNum_tmp[maxInd]) {
             Q.push(make_pair(coveredNum_tmp[maxInd], maxInd));
+            profile_count(COUNTER_HEAP_PUSHES);
             continue;
         }
         influence += coveredNum_tmp[maxInd];
         S.emplace_back(maxInd);
-        num_neighbours[u0]++;
+        quota.take(maxInd);
         nodeRemain[maxInd] = false;
-        for (int64 RIIndex : covered[maxInd]) {
+        for (int64 RIIndex : R.covered[maxInd]) {
             if (RIsetCovered[RIIndex]) continue;
-            for (node u : RRI[RIIndex]) {
+            for (node u : R.sets[RIIndex]) {
                 if (nodeRemain[u]) coveredNum_tmp[u]--;
             }
             RIsetCovered[RIIndex] = true;
         }
     }
     for (node i : N) nodeRemain[i] = false;
-    delete[] num_neighbours;
-    delete[] f;
-    return (double) influence / RRI.size();
+    return (double) influence / R.sets.size();
 }
 
 /*!
@@ -346,6 +377,7 @@ void IMMSampling_advanced(Graph &graph, vector<node> &A, int32 k, double eps, do
     int32 kA = 0;
     for (node u : A) kA += min(k, (int32) graph.g[u].size());
     kA = min(kA, (int32)graph.n);
+    ctx().fit(graph);
     double epsilon_prime = eps * sqrt(2);
     double LB = 1;
     vector<node> S_tmp;
@@ -355,8 +387,7 @@ void IMMSampling_advanced(Graph &graph, vector<node> &A, int32 k, double eps, do
                            (iota * log(graph.n) + Math::logcnk(graph.n, kA) + log(Math::log2(graph.n))) *
                            pow(2.0, i) / Math::sqr(epsilon_prime));
         if (verbose_flag) cout << "\tci = " << ci << endl;
-        while (RRI.size() < ci)
-            insert_R(graph);
+        fill_R(graph, ci);
 
         double ept = IMMNodeSelection_advanced(graph, A, k, S_tmp);
         if (ept > 1.0 / pow(2.0, i)) {
@@ -368,8 +399,7 @@ void IMMSampling_advanced(Graph &graph, vector<node> &A, int32 k, double eps, do
     double alpha = sqrt(iota * log(graph.n) + log(2));
     double beta = sqrt((1.0 - 1.0 / e) * (Math::logcnk(graph.n, kA) + iota * log(graph.n) + log(2)));
     auto C = (int64) (2.0 * graph.n * Math::sqr((1.0 - 1.0 / e) * alpha + beta) / LB / Math::sqr(eps));
-    while (RRI.size() < C)
-        insert_R(graph);
+    fill_R(graph, C);
     if (verbose_flag) cout << "\tfinal C = " << C << endl;
 }
 
@@ -385,12 +415,19 @@ void IMMSampling_advanced(Graph &graph, vector<node> &A, int32 k, double eps, do
 void IMM_advanced(Graph &G, vector<node> &A, int32 k, double eps, double iota, vector<node> &S) {
     //init_R();
     double iota_new = iota * (1.0 + log(2) / log(G.n));
-    IMMSampling_advanced(G, A, k, eps, iota_new);
+    if (pipeline_flag) {
+        int32 kA = 0;
+        for (node u : A) kA += min(k, (int32) G.g[u].size());
+        kA = min(kA, (int32) G.n);
+        vector<node> S_tmp;
+        IMMSampling_pipelined(G, kA, eps, iota_new, 100000000,
+                              [&]() { return IMMNodeSelection_advanced(G, A, k, S_tmp); });
+    } else IMMSampling_advanced(G, A, k, eps, iota_new);
     IMMNodeSelection_advanced(G, A, k, S);
 }
 
 void advanced_IMM_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
-    double cur = clock();
+    double cur = wall_clock();
     IMM_advanced(graph, A, k, 0.5, 1, seeds);
     if(verbose_flag) printf("IMM advanced done. total time = %.3f\n", time_by(cur));
 }
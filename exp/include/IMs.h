@@ -6,91 +6,156 @@
 #define EXP_IMS_H
 
 #include "simulation.h"
+#include "bounds.h"
+#include "mg0.h"
+#include "participant.h"
+#include "pagerank.h"
 #include <queue>
 #include <stack>
 
 /*!
- * @brief MG0[u] stores influence spread of {u}
+ * @brief A heap entry of the lazy greedy.
+ *
+ * mg : marginal gain on the seed set of size flag (an upper bound of it if flag = -1)
+ * prev_best, mg2 : CELF++ lookahead, the best node when v was evaluated and the gain of v on seeds + {prev_best}
  */
-double MG0[MAX_NODE_SIZE];
+struct CELF_entry {
+    double mg;
+    node v;
+    int64 flag;
+    node prev_best;
+    double mg2;
+
+    bool operator<(const CELF_entry &other) const {
+        return mg < other.mg;
+    }
+};
 
 /*!
- * @brief CELF algorithm is used to select k most influential nodes at a given candidate.
+ * @brief CELF++ lazy greedy with upper-bound initialization.
+ *
+ * The candidates enter the heap with the singleton upper bounds and are only evaluated when they reach the top,
+ * so a candidate whose bound is below the final gains is never simulated. When the bounds are not worth computing
+ * for so few candidates (see use_singleton_bounds), they enter with +inf instead. With the MC estimator and fixed rounds,
+ * the evaluation of v also estimates its gain on seeds + {cur_best} in the same worlds (cur_best is the best node
+ * evaluated in this iteration). If cur_best is selected next, the gain of v is known without another simulation.
  * @param graph : the graph
- * @param k : the number of nodes to be selected
  * @param candidate : the candidate node set
- * @param seeds : returns the most influential nodes set
+ * @param limit : the maximum number of nodes to be selected
+ * @param seeds : returns the selected nodes
+ * @param available : available(v) is false if v can no longer be selected, and v is dropped
+ * @param on_select : called with v when v is selected
+ * @param name : the name in the verbose message
  */
-void CELF(Graph &graph, int32 k, vector<node> &candidate, vector<node> &seeds) {
-    if (k >= candidate.size()) {
-        seeds = candidate;
-        if(verbose_flag) printf("Nodes are not exceeding k. All selected.\n");
-        return;
-    }
-    double cur = clock();
-    int64 r = 0;
-    /// first double : magimal influence
-    /// first node : index
-    /// second int64 : iteration round
-    typedef pair<double, pair<node, int64> > node0;
-    priority_queue<node0> Q;
-    seeds.resize(1);
-    for (node u : candidate) {
-        seeds[0] = u;
-        if(!local_mg) Q.push(make_pair(MC_simulation(graph, seeds), make_pair(u, 0)));
-        else Q.push(make_pair(MG0[u], make_pair(u, 0)));
+template<class Available, class OnSelect>
+void lazy_greedy(Graph &graph, vector<node> &candidate, int64 limit, vector<node> &seeds,
+                 Available available, OnSelect on_select, const char *name) {
+    double cur = wall_clock();
+    int64 r = 0, rounds_before = MC_rounds_used, calls_before = MC_simulation_calls, evaluated = 0, lookahead_hits = 0;
+    //the snapshot and sketch estimators keep the current seed set and evaluate marginal gains directly
+    std::shared_ptr<SnapshotOracle> snapshots;
+    std::shared_ptr<SketchOracle> sketches;
+    std::unique_lock<std::mutex> in_use;
+    estimator_type spread_estimator = ctx().spread_estimator;
+    if (spread_estimator == SNAPSHOT_ESTIMATOR) snapshots = snapshots_of(graph);
+    if (spread_estimator == SKETCH_ESTIMATOR) sketches = sketches_of(graph);
+    if (snapshots) in_use = std::unique_lock<std::mutex>(snapshots->use), snapshots->reset();
+    if (sketches) in_use = std::unique_lock<std::mutex>(sketches->use), sketches->reset();
+    bool lookahead = spread_estimator == MC_ESTIMATOR && MC_rel_error <= 0;
+    priority_queue<CELF_entry> Q;
+    if (local_mg) {
+        double *mg0 = local_MG0(graph);
+        for (node u : candidate) Q.push(CELF_entry{mg0[u], u, 0, -1, 0});
+    } else if (use_singleton_bounds(graph, (int64) candidate.size())) {
+        vector<double> &bound = singleton_upper_bounds(graph);
+        for (node u : candidate) Q.push(CELF_entry{bound[u], u, -1, -1, 0});
+    } else {
+        //the plain CELF++ first pass : every candidate is evaluated once
+        for (node u : candidate) Q.push(CELF_entry{INFINITY, u, -1, -1, 0});
     }
-    double current_spread = 0;
+    double current_spread = 0, cur_best_mg = -1;
+    node last_seed = -1, cur_best = -1;
+    //every pop that is not a selection re-evaluates the gain of the node, from its bound or a stale gain
+    auto pushes = (int64) Q.size(), reevaluations = (int64) 0;
     seeds.clear();
     if(verbose_flag) printf("\tInitialization time = %.5f\n", time_by(cur));
-    while (seeds.size() < k) {
-        r++;
-        node0 u = Q.top();
+    while (!Q.empty() && seeds.size() < limit) {
+        CELF_entry u = Q.top();
         Q.pop();
-        if (u.second.second == seeds.size()) {
+        if (!available(u.v)) continue;
+        r++;
+        auto s = (int64) seeds.size();
+        if (u.flag == s) {
             if(verbose_flag) {
-                cout << "\tnode = " << u.second.first << "\tround = " << r << "\ttime = " <<time_by(cur) << endl;
+                cout << "\tnode = " << u.v << "\tround = " << r << "\ttime = " <<time_by(cur) << endl;
             }
-            seeds.emplace_back(u.second.first);
-            current_spread += u.first;
+            seeds.emplace_back(u.v);
+            current_spread += u.mg;
+            on_select(u.v);
+            if (snapshots) snapshots->add_seed(u.v);
+            if (sketches) sketches->add_seed(u.v);
+            last_seed = u.v, cur_best = -1, cur_best_mg = -1;
+            continue;
+        }
+        if (u.flag == -1) evaluated++;
+        reevaluations++;
+        if (lookahead && u.flag == s - 1 && u.prev_best != -1 && u.prev_best == last_seed) {
+            u.mg = u.mg2;
+            lookahead_hits++;
+        } else if (snapshots) {
+            u.mg = snapshots->marginal_gain(u.v);
+        } else if (sketches) {
+            u.mg = sketches->marginal_gain(u.v);
+        } else if (lookahead) {
+            double with_best;
+            u.prev_best = cur_best != u.v ? cur_best : -1;
+            seeds.emplace_back(u.v);
+            double spread = MC_lookahead(graph, seeds, u.prev_best, with_best);
+            seeds.pop_back();
+            u.mg = spread - current_spread;
+            u.mg2 = with_best - (current_spread + cur_best_mg);
         } else {
-            seeds.emplace_back(u.second.first);
-            u.first = MC_simulation(graph, seeds) - current_spread;
+            //with adaptive rounds, stop as soon as u clearly cannot beat the next heap top
+            double threshold = (MC_rel_error > 0 && !Q.empty()) ? current_spread + Q.top().mg : -1, upper;
+            seeds.emplace_back(u.v);
+            double spread = estimate_spread(graph, seeds, threshold, &upper);
             seeds.pop_back();
-            u.second.second = seeds.size();
-            Q.push(u);
+            if (upper < threshold) {
+                //keep u stale with its upper bound
+                u.mg = upper - current_spread;
+                Q.push(u), pushes++;
+                continue;
+            }
+            u.mg = spread - current_spread;
         }
+        u.flag = s;
+        if (u.mg > cur_best_mg) cur_best = u.v, cur_best_mg = u.mg;
+        Q.push(u), pushes++;
+    }
+    profile_count(COUNTER_HEAP_PUSHES, pushes);
+    profile_count(COUNTER_CELF_REEVALUATIONS, reevaluations);
+    if(verbose_flag) {
+        printf("%s done. total time = %.3f, MC rounds used = %ld, MC_simulation calls = %ld, "
+               "candidates simulated = %ld / %ld, lookahead hits = %ld\n", name, time_by(cur),
+               (long) (MC_rounds_used - rounds_before), (long) (MC_simulation_calls - calls_before),
+               (long) evaluated, (long) candidate.size(), (long) lookahead_hits);
     }
-    if(verbose_flag) printf("CELF done. total time = %.3f\n", time_by(cur));
 }
 
 /*!
- * @brief Use power iteration method to calculate pagerank values of nodes in graph.
- * @remarks Note that if there are isolated nodes in the graph, the iteration will not stop causing an error.
+ * @brief CELF algorithm is used to select k most influential nodes at a given candidate.
  * @param graph : the graph
- * @param pi : returns a size-n vector, containing pagerank values of all nodes
- * @param alpha : initialized usually as 0.15 or 0.2
- * @param l1_error : The precision that needs to be achieved
+ * @param k : the number of nodes to be selected
+ * @param candidate : the candidate node set
+ * @param seeds : returns the most influential nodes set
  */
-void power_iteration(Graph &graph, vector<double> &pi, double alpha, double l1_error = 1e-9) {
-    vector<double> residuals(graph.n, 1.0 / graph.n);
-    vector<double> new_residuals(graph.n, 0);
-    double r_sum = 1;
-    for (uint32_t num_iter = 0; r_sum > l1_error; ++num_iter) {
-        for (node id = 0; id < graph.n; ++id) {
-            node degree = graph.deg_out[id];
-            double alpha_residual = alpha * residuals[id];
-            pi[id] += alpha_residual;
-            r_sum -= alpha_residual;
-            double increment = (residuals[id] - alpha_residual) / degree;
-            residuals[id] = 0;
-            for (auto &edges:graph.g[id]) {
-                int nid = edges.v;
-                new_residuals[nid] += increment;
-            }
-        }
-        residuals.swap(new_residuals);
+void CELF(Graph &graph, int32 k, vector<node> &candidate, vector<node> &seeds) {
+    if (k >= candidate.size()) {
+        seeds = candidate;
+        if(verbose_flag) printf("Nodes are not exceeding k. All selected.\n");
+        return;
     }
+    lazy_greedy(graph, candidate, k, seeds, [](node v) { return true; }, [](node v) {}, "CELF");
 }
 
 /*!
@@ -101,18 +166,14 @@ void power_iteration(Graph &graph, vector<double> &pi, double alpha, double l1_e
  * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
  */
 void pgrank_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
-    vector<double> pi(graph.n, 0);
-    power_iteration(graph, pi, 0.2);
+    auto snapshot = pagerank(graph, 0.2);
+    const vector<double> &pi = *snapshot;
+    ParticipantIndex &index = participant_index(graph, A);
     vector<pair<double, node> > pg_rank;
     set<node> seeds_reorder;
-    for (node u : A) {
+    for (int64 j = 0; j < A.size(); j++) {
         pg_rank.clear();
-        for (auto &edge : graph.g[u]) {
-            node v = edge.v;
-            if(find(A.begin(), A.end(), v) == A.end()) {
-                pg_rank.emplace_back(make_pair(pi[v], v));
-            }
-        }
+        for (node v : index.neighbours(j)) pg_rank.emplace_back(make_pair(pi[v], v));
         sort(pg_rank.begin(), pg_rank.end());
         reverse(pg_rank.begin(), pg_rank.end());
         for (int32 i = 0; i < k && i < pg_rank.size(); i++)
@@ -131,16 +192,12 @@ void pgrank_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds)
  * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
  */
 void degree_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
+    ParticipantIndex &index = participant_index(graph, A);
     vector<pair<node , node> > degree_rank;
     set<node> seeds_reorder;
-    for (node u : A) {
+    for (int64 j = 0; j < A.size(); j++) {
         degree_rank.clear();
-        for (auto &edge : graph.g[u]) {
-            node v = edge.v;
-            if(find(A.begin(), A.end(), v) == A.end()) {
-                degree_rank.emplace_back(make_pair(graph.deg_out[v], v));
-            }
-        }
+        for (node v : index.neighbours(j)) degree_rank.emplace_back(make_pair(graph.deg_out[v], v));
         sort(degree_rank.begin(), degree_rank.end());
         reverse(degree_rank.begin(), degree_rank.end());
         for (int32 i = 0; i < k && i < degree_rank.size(); i++)
@@ -159,15 +216,11 @@ void degree_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds)
  * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
  */
 void CELF_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
-    double cur = clock();
+    double cur = wall_clock();
+    ParticipantIndex &index = participant_index(graph, A);
     set<node> seeds_reorder;
-    for (node u : A) {
-        vector<node> neighbours, one_seed;
-        for (auto &edge : graph.g[u]) {
-            if(find(A.begin(), A.end(), edge.v) == A.end()) {
-                neighbours.emplace_back(edge.v);
-            }
-        }
+    for (int64 j = 0; j < A.size(); j++) {
+        vector<node> neighbours(index.neighbours(j).begin(), index.neighbours(j).end()), one_seed;
         CELF(graph, k, neighbours, one_seed);
         for (node w : one_seed)
             seeds_reorder.insert(w);
@@ -177,45 +230,225 @@ void CELF_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
     if(verbose_flag) printf("CELF method done. total time = %.3f\n", time_by(cur));
 }
 
+/*!
+ * @brief A partial solution of enumeration_method : the neighbours picked for the first j participants.
+ */
+struct enum_branch {
+    int64 j;
+    vector<node> S;
+    double value;
+};
+
 /*!
  * @brief Encapsulated operations for Option 1
+ *
+ * Every participant A[j] picks min(k, available) of its neighbours that are neither in A nor picked by an
+ * earlier participant. The solutions are enumerated depth-first without being stored, and sigma is estimated
+ * when a participant finishes its picks. Since sigma is submodular, a branch can reach at most its spread
+ * plus, for every remaining participant, the sum of its k largest single-node spreads, and it is pruned when
+ * this bound is not above the best solution found so far. The first levels are expanded into subtrees that
+ * run on the thread pool and share the best solution, as long as a level has at most 64 branches per thread; the
+ * children are pruned by the bound before they are estimated. If there are still too few subtrees, the picks of
+ * their next participant are split by the first pick, and every part is enumerated by the thread that takes it.
  * @param graph : the graph
  * @param k : the number in the problem definition
  * @param A : the active participant set A
  * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
  */
 void enumeration_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
-    vector<vector<node> > V_n;
-    vector<double> value;
-    select_neighbours(graph, A, V_n, k, 0, 0, A.begin(), true);
-    if(verbose_flag) cout << "The size of the solution space : " << V_n.size() << endl;
-    for (auto &S_n : V_n) {
-        if(verbose_flag) print_set(S_n, "set S = ");
-        double x = MC_simulation(graph, S_n);
-        value.emplace_back(x);
-        if(verbose_flag) printf(" simulation result = %.5f\n", x);
+    double cur = wall_clock();
+    ThreadPool &pool = thread_pool();
+    //the snapshot estimator keeps one seed set and cannot be shared by threads
+    estimator_type spread_estimator = ctx().spread_estimator;
+    bool parallel = spread_estimator != SNAPSHOT_ESTIMATOR;
+    //the sketches are read-only after they are built, so build them before the threads use them
+    if (spread_estimator == SKETCH_ESTIMATOR) sketches_of(graph);
+    auto run = [&](int64 tasks, const std::function<void(int32, int64)> &f) {
+        if (parallel) pool.parallel_for(tasks, f);
+        else for (int64 i = 0; i < tasks; i++) f(0, i);
+    };
+    auto m = (int64) A.size();
+    ParticipantIndex &index = participant_index(graph, A);
+    //cand[j] : neighbours of A[j] that are not in A, sorted by single-node spread
+    vector<vector<node>> cand(m);
+    for (int64 j = 0; j < m; j++) cand[j].assign(index.neighbours(j).begin(), index.neighbours(j).end());
+    vector<node> &all = index.candidates;
+    vector<double> single(graph.n, 0);
+    if (local_mg) {
+        double *mg0 = local_MG0(graph);
+        for (node v : all) single[v] = mg0[v];
+    } else {
+        run((int64) all.size(), [&](int32 tid, int64 i) {
+            vector<node> S(1, all[i]);
+            single[all[i]] = estimate_spread(graph, S);
+        });
+    }
+    //suffix[j] : the most that participants j .. m-1 can add
+    vector<double> suffix(m + 1, 0);
+    for (int64 j = m - 1; j >= 0; j--) {
+        sort(cand[j].begin(), cand[j].end(), [&](node a, node b) { return single[a] > single[b]; });
+        suffix[j] = suffix[j + 1];
+        for (int64 i = 0; i < min((int64) k, (int64) cand[j].size()); i++) suffix[j] += single[cand[j][i]];
     }
-    double max_value = 0;
-    for (int64 i = 1; i < value.size(); i++) if (value[i] > value[max_value]) max_value = i;
-    seeds = V_n[max_value];
-}
 
-/*!
- * @brief Select an active participant u of node v, and remove u from f[v] if u does not meet the criteria.
- * @param v : the candidate neighbour node
- * @param f : the source active participant set of v
- * @param k : Predefined k
- * @param num_neighbours : num_neighbours[u] means how many neighbours that active participant u has been selected
- * @return : the source active participant of v, and -1 if no node meets the criteria.
- */
-node source_participant(node v, vector<node> f[], const int32 k, const node num_neighbours[]) {
-    if(f[v].empty()) return -1;
-    node u = f[v][0];
-    for(int i = 1; i < f[v].size(); i++) {
-        if(num_neighbours[f[v][i]] < num_neighbours[u]) u = f[v][i];
+    std::mutex best_mtx;
+    double best_value = -1;
+    vector<node> best_set;
+    std::atomic<int64> leaves(0), pruned(0);
+    auto best_now = [&]() {
+        std::lock_guard<std::mutex> lock(best_mtx);
+        return best_value;
+    };
+    auto offer = [&](vector<node> &S, double value) {
+        std::lock_guard<std::mutex> lock(best_mtx);
+        if (value > best_value) best_value = value, best_set = S;
+    };
+    ///picked[tid][v] : v is in the branch that thread tid is working on
+    vector<vector<bool>> picked(parallel ? pool.size() : 1, vector<bool>());
+
+    //the neighbours of participant b.j that are still available, and how many of them it picks
+    auto available = [&](enum_branch &b, vector<bool> &mark, vector<node> &avail) {
+        avail.clear();
+        for (node v : cand[b.j]) if (!mark[v]) avail.emplace_back(v);
+        return min((int64) k, (int64) avail.size());
+    };
+    //call visit(S') for every way that participant b.j picks its neighbours, S' = b.S + the picks.
+    //If first >= 0, only the ways whose first pick is the first-th available neighbour.
+    auto for_each_pick = [&](enum_branch &b, vector<bool> &mark, const std::function<void(vector<node> &)> &visit,
+                             int64 first = -1) {
+        vector<node> avail;
+        auto c = available(b, mark, avail);
+        vector<node> S = b.S;
+        std::function<void(int64, int64)> comb = [&](int64 from, int64 left) {
+            if (left == 0) {
+                visit(S);
+                return;
+            }
+            for (int64 i = from; i + left <= avail.size(); i++) {
+                S.emplace_back(avail[i]);
+                comb(i + 1, left - 1);
+                S.pop_back();
+            }
+        };
+        if (first < 0) comb(0, c);
+        else if (c > 0 && first + c <= avail.size()) S.emplace_back(avail[first]), comb(first + 1, c - 1);
+    };
+    //the bound before sigma(S') is estimated : b.value plus the single-node spreads of the picks
+    auto cheap_bound = [&](enum_branch &b, vector<node> &S) {
+        double res = b.value + suffix[b.j + 1];
+        for (auto i = (int64) b.S.size(); i < S.size(); i++) res += single[S[i]];
+        return res;
+    };
+
+    std::function<void(enum_branch &, vector<bool> &)> dfs;
+    //estimate the child S of b and search it, unless the bound prunes it
+    auto descend = [&](enum_branch &b, vector<bool> &mark, vector<node> &S) {
+        if (cheap_bound(b, S) <= best_now()) {
+            pruned++;
+            return;
+        }
+        enum_branch child{b.j + 1, S, S.size() == b.S.size() ? b.value : estimate_spread(graph, S)};
+        for (auto i = (int64) b.S.size(); i < S.size(); i++) mark[S[i]] = true;
+        dfs(child, mark);
+        for (auto i = (int64) b.S.size(); i < S.size(); i++) mark[S[i]] = false;
+    };
+    dfs = [&](enum_branch &b, vector<bool> &mark) {
+        if (b.j == m) {
+            leaves++;
+            offer(b.S, b.value);
+            return;
+        }
+        if (b.value + suffix[b.j] <= best_now()) {
+            pruned++;
+            return;
+        }
+        for_each_pick(b, mark, [&](vector<node> &S) { descend(b, mark, S); });
+    };
+
+    //expand the first levels until there are enough subtrees for the threads, or the next level would be too large
+    vector<enum_branch> frontier(1, enum_branch{0, vector<node>(), 0});
+    vector<bool> mark(graph.n, false);
+    vector<node> avail;
+    auto cap = (double) 64 * pool.size();
+    while (frontier.size() < 4 * pool.size()) {
+        //the size of the next level, C(available, picks) for every branch, counted up to the cap
+        double size = 0;
+        bool expandable = false;
+        for (auto &b : frontier) {
+            if (b.j == m) {
+                size++;
+                continue;
+            }
+            expandable = true;
+            for (node v : b.S) mark[v] = true;
+            auto c = available(b, mark, avail);
+            for (node v : b.S) mark[v] = false;
+            double ways = 1;
+            for (int64 i = 0; i < c && ways <= cap; i++) ways = ways * (double) (avail.size() - i) / (double) (i + 1);
+            size += ways;
+        }
+        if (!expandable || size > cap) break;
+        vector<enum_branch> next;
+        for (auto &b : frontier) {
+            if (b.j == m) {
+                next.emplace_back(b);
+                continue;
+            }
+            for (node v : b.S) mark[v] = true;
+            for_each_pick(b, mark, [&](vector<node> &S) {
+                if (cheap_bound(b, S) <= best_now()) pruned++;
+                else next.emplace_back(enum_branch{b.j + 1, S, S.size() == b.S.size() ? b.value : -1});
+            });
+            for (node v : b.S) mark[v] = false;
+        }
+        //the branches with new picks are estimated in parallel, then the finished ones raise the best solution
+        run((int64) next.size(), [&](int32 tid, int64 i) {
+            if (next[i].value < 0) next[i].value = estimate_spread(graph, next[i].S);
+        });
+        for (auto &b : next)
+            if (b.j == m) offer(b.S, b.value);
+        frontier.clear();
+        for (auto &b : next) {
+            if (b.j < m && b.value + suffix[b.j] <= best_now()) pruned++;
+            else frontier.emplace_back(std::move(b));
+        }
+    }
+    sort(frontier.begin(), frontier.end(), [&](const enum_branch &a, const enum_branch &b) {
+        return a.value + suffix[a.j] > b.value + suffix[b.j];
+    });
+    //tasks : (subtree, first pick of its next participant), -1 for the whole subtree
+    vector<pair<int64, int64>> tasks;
+    bool split = frontier.size() < 4 * pool.size();
+    for (int64 i = 0; i < frontier.size(); i++) {
+        auto &b = frontier[i];
+        if (!split || b.j == m) {
+            tasks.emplace_back(i, -1);
+            continue;
+        }
+        for (node v : b.S) mark[v] = true;
+        auto c = available(b, mark, avail);
+        for (node v : b.S) mark[v] = false;
+        if (c == 0) tasks.emplace_back(i, -1);
+        for (int64 first = 0; c > 0 && first + c <= avail.size(); first++) tasks.emplace_back(i, first);
+    }
+    if (verbose_flag)
+        printf("\tsubtrees = %ld, tasks = %ld, expansion time = %.3f\n", (long) frontier.size(), (long) tasks.size(),
+               time_by(cur));
+    run((int64) tasks.size(), [&](int32 tid, int64 t) {
+        vector<bool> &mk = picked[tid];
+        if (mk.size() < graph.n) mk.assign(graph.n, false);
+        enum_branch &b = frontier[tasks[t].first];
+        for (node v : b.S) mk[v] = true;
+        if (tasks[t].second < 0) dfs(b, mk);
+        else if (b.value + suffix[b.j] <= best_now()) pruned++;
+        else for_each_pick(b, mk, [&](vector<node> &S) { descend(b, mk, S); }, tasks[t].second);
+        for (node v : b.S) mk[v] = false;
+    });
+    seeds = best_set;
+    if (verbose_flag) {
+        printf("enumeration done. best = %.3f, leaves = %ld, pruned = %ld, total time = %.3f\n", best_value,
+               (long) leaves, (long) pruned, time_by(cur));
     }
-    if(num_neighbours[u] >= k) return -1;
-    return u;
 }
 
 /*!
@@ -226,33 +459,51 @@ node source_participant(node v, vector<node> f[], const int32 k, const node num_
  * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
  */
 void advanced_pgrank_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
-    vector<double> pi(graph.n, 0);
-    power_iteration(graph, pi, 0.2);
-    set<node> S; //candidate neighbour set
+    auto snapshot = pagerank(graph, 0.2);
+    const vector<double> &pi = *snapshot;
+    ParticipantIndex &index = participant_index(graph, A);
+    ParticipantQuota quota(index, k);
     vector<pair<double, node> > S_ordered;
-    auto *num_neighbours = new node [graph.n]();
-    auto *f = new vector<node>[graph.n](); //f[v] means in-coming active participant of v
-    for (node u : A)
-        for (auto &edge : graph.g[u]) {
-            if(find(A.begin(), A.end(), edge.v) == A.end()) {
-                S.insert(edge.v);
-                f[edge.v].emplace_back(u);
-            }
-        }
-    for (node w : S) shuffle(f[w].begin(), f[w].end(), std::mt19937(std::random_device()()));
-    for (node w : S) S_ordered.emplace_back(make_pair(pi[w], w));
+    for (node w : index.candidates) S_ordered.emplace_back(make_pair(pi[w], w));
     //S_ordered is ordered by pageRank
     sort(S_ordered.begin(), S_ordered.end());
     reverse(S_ordered.begin(), S_ordered.end());
     for (int64 i = 0; i < S_ordered.size(); i++) {
         node v = S_ordered[i].second;
-        node u = source_participant(v, f, k, num_neighbours);
-        if (u == -1) continue;
-        num_neighbours[u]++;
+        if (!quota.available(v)) continue;
+        quota.take(v);
+        seeds.emplace_back(v);
+    }
+}
+
+/*!
+ * @brief Encapsulated operations for IM solver : personalized pagerank from A
+ *
+ * The candidates are ranked by their personalized pagerank with A as the sources, computed by a local forward
+ * push, and selected in this order under the quota of the advanced solvers. Unlike the global pagerank, only the
+ * neighbourhood of A is explored.
+ * @param graph : the graph
+ * @param k : the number in the problem definition
+ * @param A : the active participant set A
+ * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
+ */
+void local_ppr_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
+    int64 explored;
+    const vector<double> &ppr = local_ppr(graph, A, 0.2, ppr_rmax, explored);
+    if (verbose_flag) printf("\tlocal ppr explored %ld nodes\n", (long) explored);
+    ParticipantIndex &index = participant_index(graph, A);
+    ParticipantQuota quota(index, k);
+    vector<pair<double, node> > S_ordered;
+    for (node w : index.candidates) S_ordered.emplace_back(make_pair(ppr[w], w));
+    //S_ordered is ordered by personalized pageRank
+    sort(S_ordered.begin(), S_ordered.end());
+    reverse(S_ordered.begin(), S_ordered.end());
+    for (int64 i = 0; i < S_ordered.size(); i++) {
+        node v = S_ordered[i].second;
+        if (!quota.available(v)) continue;
+        quota.take(v);
         seeds.emplace_back(v);
     }
-    delete[] num_neighbours;
-    delete[] f;
 }
 
 /*!
@@ -263,31 +514,19 @@ void advanced_pgrank_method(Graph &graph, int32 k, vector<node> &A, vector<node>
  * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
  */
 void advanced_degree_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
-    set<node> S; //candidate neighbour set
+    ParticipantIndex &index = participant_index(graph, A);
+    ParticipantQuota quota(index, k);
     vector<pair<double, node> > S_ordered;
-    auto *num_neighbours = new node [graph.n]();
-    auto *f = new vector<node>[graph.n](); //f[v] means in-coming active participant of v
-    for (node u : A)
-        for (auto &edge : graph.g[u]) {
-            if(find(A.begin(), A.end(), edge.v) == A.end()) {
-                S.insert(edge.v);
-                f[edge.v].emplace_back(u);
-            }
-        }
-    for (node w : S) shuffle(f[w].begin(), f[w].end(), std::mt19937(std::random_device()()));
-    for (node w : S) S_ordered.emplace_back(make_pair(graph.deg_out[w], w));
+    for (node w : index.candidates) S_ordered.emplace_back(make_pair(graph.deg_out[w], w));
     //S_ordered is ordered by degree
     sort(S_ordered.begin(), S_ordered.end());
     reverse(S_ordered.begin(), S_ordered.end());
     for (int64 i = 0; i < S_ordered.size(); i++) {
         node v = S_ordered[i].second;
-        node u = source_participant(v, f, k, num_neighbours);
-        if (u == -1) continue;
-        num_neighbours[u]++;
+        if (!quota.available(v)) continue;
+        quota.take(v);
         seeds.emplace_back(v);
     }
-    delete[] num_neighbours;
-    delete[] f;
 }
 
 /*!
@@ -298,65 +537,11 @@ void advanced_degree_method(Graph &graph, int32 k, vector<node> &A, vector<node>
  * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
  */
 void advanced_CELF_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
-    double cur = clock();
-    int64 r = 0;
-    set<node> S; //candidate neighbour set
-    auto *num_neighbours = new node [graph.n]();
-    auto *f = new vector<node>[graph.n](); //f[v] means in-coming active participant of v
-    //push all candidate neighbour to S, and update f
-    for (node u : A){
-        for (auto &edge : graph.g[u]) {
-            if(find(A.begin(), A.end(), edge.v) == A.end()) {
-                S.insert(edge.v);
-                f[edge.v].emplace_back(u);
-            }
-        }
-    }
-    for (node w : S) {
-        shuffle(f[w].begin(), f[w].end(), std::mt19937(std::random_device()()));
-    }
-    typedef pair<double, pair<node, int64> > node0;
-    priority_queue<node0> Q;
-    seeds.resize(1); //Add a temporary space
-    for (node u : S) {
-        seeds[0] = u;
-        if(!local_mg) {
-            Q.push(make_pair(MC_simulation(graph, seeds), make_pair(u, 0)));
-        }
-        else {
-            Q.push(make_pair(MG0[u], make_pair(u, 0)));
-        }
-    }
-    double current_spread = 0;
-    seeds.pop_back(); //Clear the temporary space
-    if(verbose_flag) printf("\tInitialization time = %.5f\n", time_by(cur));
-    while (!Q.empty()) {
-        node0 Tp = Q.top();
-        node v = Tp.second.first;
-        int64 it_round = Tp.second.second;
-        double mg = Tp.first;
-        Q.pop();
-        node u = source_participant(v, f, k, num_neighbours);
-        if (u == -1) continue;
-        r++;
-        if (it_round == seeds.size()) {
-            num_neighbours[u]++;
-            seeds.emplace_back(v);
-            current_spread += mg;
-            if(verbose_flag) {
-                cout << "\tnode = " << v << "\tround = " << r << "\ttime = " <<time_by(cur) << endl;
-            }
-        } else {
-            seeds.emplace_back(v);
-            Tp.first = MC_simulation(graph, seeds) - current_spread;
-            seeds.pop_back();
-            Tp.second.second = seeds.size();
-            Q.push(Tp);
-        }
-    }
-    delete[] num_neighbours;
-    delete[] f;
-    if(verbose_flag) printf("CELF advanced done. total time = %.3f\n", time_by(cur));
+    ParticipantIndex &index = participant_index(graph, A);
+    ParticipantQuota quota(index, k);
+    lazy_greedy(graph, index.candidates, graph.n, seeds,
+                [&](node v) { return quota.available(v); },
+                [&](node v) { quota.take(v); }, "CELF advanced");
 }
 
 #endif //EXP_IMS_H
@@ -0,0 +1,364 @@
+// OPIM-C : online IMM with early stopping
+
+#ifndef EXP_OPIM_H
+#define EXP_OPIM_H
+
+#include "IMM.h"
+#include "bounds.h"
+#include <chrono>
+
+typedef std::chrono::steady_clock::time_point time_point;
+
+/*!
+ * @brief Greedy selection on R1 that also returns the upper bound on the coverage of the optimal solution.
+ *
+ * At every step the coverage of the optimal size-k set is at most the current coverage plus the
+ * sum of the k largest marginal coverages, and the minimum of these bounds is returned.
+ * @param R : the RI sets
+ * @param candidate : candidate node set in which seed set can choose nodes
+ * @param k : the size of S
+ * @param S : returns S as an passed parameter
+ * @param limit : only use the first `limit` RI sets of R, -1 for all
+ * @return : the upper bound of coverage of the optimal solution in these RI sets
+ */
+int64 OPIMNodeSelection(RRcollection &R, vector<node> &candidate, int32 k, vector<node> &S, int64 limit = -1) {
+    phase_timer timer(PHASE_NODE_SELECTION);
+    S.clear();
+    bool all = limit < 0 || limit >= R.sets.size();
+    if (all) limit = (int64) R.sets.size();
+    vector<bool> &nodeRemain = ctx().nodeRemain;
+    vector<int64> &coveredNum_tmp = ctx().coveredNum_tmp;
+    vector<bool> RIsetCovered(limit, false);
+    for (node i : candidate) nodeRemain[i] = true, coveredNum_tmp[i] = all ? R.coveredNum[i] : R.covered_in(i, limit);
+    vector<int64> top(candidate.size());
+    int64 influence = 0, upper = INT64_MAX;
+    auto update_upper = [&]() {
+        top.clear();
+        for (node i : candidate) if (nodeRemain[i]) top.emplace_back(coveredNum_tmp[i]);
+        int64 kk = min((int64) k, (int64) top.size()), sum = influence;
+        nth_element(top.begin(), top.begin() + kk, top.end(), greater<int64>());
+        for (int64 i = 0; i < kk; i++) sum += top[i];
+        upper = min(upper, sum);
+    };
+    priority_queue<pair<int64, node>> Q;
+    for (node i : candidate) Q.push(make_pair(coveredNum_tmp[i], i));
+    profile_count(COUNTER_HEAP_PUSHES, (int64) Q.size());
+    update_upper();
+    while (S.size() < k && !Q.empty()) {
+        int64 value = Q.top().first;
+        node maxInd = Q.top().second;
+        Q.pop();
+        if (!nodeRemain[maxInd]) continue;
+        if (value > coveredNum_tmp[maxInd]) {
+            Q.push(make_pair(coveredNum_tmp[maxInd], maxInd));
+            profile_count(COUNTER_HEAP_PUSHES);
+            continue;
+        }
+        influence += coveredNum_tmp[maxInd];
+        S.emplace_back(maxInd);
+        nodeRemain[maxInd] = false;
+        for (int64 RIIndex : R.covered[maxInd]) {
+            if (RIIndex >= limit) break;
+            if (RIsetCovered[RIIndex]) continue;
+            for (node u : R.sets[RIIndex]) {
+                if (nodeRemain[u]) coveredNum_tmp[u]--;
+            }
+            RIsetCovered[RIIndex] = true;
+        }
+        update_upper();
+    }
+    for (node i : candidate) nodeRemain[i] = false;
+    return upper;
+}
+
+/*!
+ * @brief OPIM-C : sample R1 and R2 in doubling rounds and stop as soon as the ratio (1-1/e-eps) is certified.
+ * @param graph : the graph
+ * @param candidate : candidate node set in which seed set can choose nodes
+ * @param k : the size of the seed set
+ * @param eps : argument related to accuracy.
+ * @param delta : failure probability.
+ * @param S : returns the seed set
+ * @return : the certified approximation ratio of S
+ */
+double OPIM_C(Graph &graph, vector<node> &candidate, int32 k, double eps, double delta, vector<node> &S) {
+    S.clear();
+    if (candidate.empty()) return 1;
+    Context &c = ctx();
+    c.fit(graph);
+    RRcollection &R1_opim = c.R1_opim, &R2_opim = c.R2_opim;
+    double e = exp(1), approx = 1.0 - 1.0 / e;
+    auto kk = (int32) min((int64) k, (int64) candidate.size());
+    double theta_max = 2.0 * graph.n *
+                       Math::sqr(approx * sqrt(log(6.0 / delta)) +
+                                 sqrt(approx * (Math::logcnk(candidate.size(), kk) + log(6.0 / delta)))) /
+                       Math::sqr(eps) / kk;
+    double theta_0 = theta_max * Math::sqr(eps) * kk / graph.n;
+    auto i_max = (int32) ceil(log2(max(2.0, theta_max / theta_0)));
+    double a = log(3.0 * i_max / delta);
+    double ratio = 0;
+    for (int32 i = 1; i <= i_max; i++) {
+        auto theta = (int64) ceil(theta_0 * pow(2.0, i - 1));
+        R1_opim.fill(graph, theta, time_point::max(), c.engine, c.ws);
+        R2_opim.fill(graph, theta, time_point::max(), c.engine, c.ws);
+        //R1 and R2 are kept between queries, so round i only uses their first theta sets
+        auto theta1 = min(theta, (int64) R1_opim.sets.size()), theta2 = min(theta, (int64) R2_opim.sets.size());
+        double upper_cov = OPIMNodeSelection(R1_opim, candidate, kk, S, theta1);
+        double lower_cov = R2_opim.coverage(S, theta2);
+        double sigma_u = spread_upper_bound(upper_cov, theta1, graph.n, a);
+        double sigma_l = spread_lower_bound(lower_cov, theta2, graph.n, a);
+        ratio = sigma_l / sigma_u;
+        if (verbose_flag) {
+            cout << "\ti = " << i << " |R1| = " << theta1 << " lower = " << sigma_l
+                 << " upper = " << sigma_u << " ratio = " << ratio << endl;
+        }
+        if (ratio >= approx - eps) break;
+    }
+    return ratio;
+}
+
+/*!
+ * @brief Encapsulated operations for Option 2 using IM solver : OPIM-C
+ * @param graph : the graph
+ * @param k : the number in the problem definition
+ * @param A : the active participant set A
+ * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
+ */
+void OPIM_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
+    double cur = wall_clock();
+    set<node> seeds_reorder;
+    double &OPIM_ratio = ctx().OPIM_ratio;
+    OPIM_ratio = 1;
+    ParticipantIndex &index = participant_index(graph, A);
+    for (int64 j = 0; j < A.size(); j++) {
+        vector<node> neighbours(index.neighbours(j).begin(), index.neighbours(j).end()), one_seed;
+        OPIM_ratio = min(OPIM_ratio, OPIM_C(graph, neighbours, k, 0.1, 1.0 / graph.n, one_seed));
+        for (node w : one_seed)
+            seeds_reorder.insert(w);
+    }
+    for (node w : seeds_reorder) seeds.emplace_back(w);
+    seeds_reorder.clear();
+    if (verbose_flag) printf("OPIM method done. total time = %.3f\n", time_by(cur));
+}
+
+///wall-clock budget in seconds of the anytime IMM mode, 0 for disabled
+double time_budget;
+
+/*!
+ * @brief Anytime IMM : sample and select in doubling rounds, and keep the best seed set found before the deadline.
+ *
+ * R1 and R2 are kept between queries and may be larger than a round needs, so round i only uses their first theta_i
+ * sets and its selection costs the same whatever the earlier queries have sampled.
+ * @param graph : the graph
+ * @param candidate : candidate node set in which seed set can choose nodes
+ * @param k : the size of the seed set
+ * @param eps : argument related to accuracy.
+ * @param delta : failure probability.
+ * @param deadline : the deadline
+ * @param S : returns the best seed set
+ * @return : the certified approximation ratio of S
+ */
+double anytime_IMM(Graph &graph, vector<node> &candidate, int32 k, double eps, double delta, time_point deadline,
+                   vector<node> &S) {
+    S.clear();
+    if (candidate.empty()) return 1;
+    Context &c = ctx();
+    c.fit(graph);
+    RRcollection &R1_opim = c.R1_opim, &R2_opim = c.R2_opim;
+    double e = exp(1), approx = 1.0 - 1.0 / e;
+    auto kk = (int32) min((int64) k, (int64) candidate.size());
+    double theta_max = 2.0 * graph.n *
+                       Math::sqr(approx * sqrt(log(6.0 / delta)) +
+                                 sqrt(approx * (Math::logcnk(candidate.size(), kk) + log(6.0 / delta)))) /
+                       Math::sqr(eps) / kk;
+    double theta_0 = theta_max * Math::sqr(eps) * kk / graph.n;
+    auto i_max = (int32) ceil(log2(max(2.0, theta_max / theta_0)));
+    double a = log(3.0 * i_max / delta), best_ratio = -1;
+    vector<node> S_tmp;
+    for (int32 i = 1; i <= i_max; i++) {
+        auto theta = (int64) ceil(theta_0 * pow(2.0, i - 1));
+        //R2 is filled even if R1 runs out of time, so that the first round has sets to certify its seed set
+        bool in_time = R1_opim.fill(graph, theta, deadline, c.engine, c.ws);
+        in_time = R2_opim.fill(graph, theta, deadline, c.engine, c.ws) && in_time;
+        //a seed set is always returned, even if the first round is not finished in time
+        if (!in_time && best_ratio >= 0) break;
+        auto theta1 = min(theta, (int64) R1_opim.sets.size()), theta2 = min(theta, (int64) R2_opim.sets.size());
+        double upper_cov = OPIMNodeSelection(R1_opim, candidate, kk, S_tmp, theta1);
+        double ratio = theta2 == 0 ? 0 : spread_lower_bound(R2_opim.coverage(S_tmp, theta2), theta2, graph.n, a) /
+                                         spread_upper_bound(upper_cov, theta1, graph.n, a);
+        if (ratio > best_ratio) best_ratio = ratio, S = S_tmp;
+        c.anytime_RR_used = theta1 + theta2;
+        if (!in_time || best_ratio >= approx - eps) break;
+    }
+    return best_ratio;
+}
+
+/*!
+ * @brief Encapsulated operations for Option 2 using IM solver : IMM with a wall-clock budget
+ *
+ * The remaining budget is split evenly between the participants that are not solved yet.
+ * @param graph : the graph
+ * @param k : the number in the problem definition
+ * @param A : the active participant set A
+ * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
+ */
+void anytime_IMM_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
+    double cur = wall_clock();
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(time_budget));
+    set<node> seeds_reorder;
+    double &OPIM_ratio = ctx().OPIM_ratio;
+    OPIM_ratio = 1;
+    ParticipantIndex &index = participant_index(graph, A);
+    for (int64 i = 0; i < A.size(); i++) {
+        vector<node> neighbours(index.neighbours(i).begin(), index.neighbours(i).end()), one_seed;
+        auto now = std::chrono::steady_clock::now();
+        auto deadline = now + (end - now) / (int64) (A.size() - i);
+        OPIM_ratio = min(OPIM_ratio, anytime_IMM(graph, neighbours, k, 0.5, 1.0 / graph.n, deadline, one_seed));
+        for (node w : one_seed)
+            seeds_reorder.insert(w);
+    }
+    for (node w : seeds_reorder) seeds.emplace_back(w);
+    seeds_reorder.clear();
+    if (verbose_flag) printf("anytime IMM method done. total time = %.3f\n", time_by(cur));
+}
+
+/*!
+ * @brief Selection phase of advanced IMM on R1 that also returns the upper bound on the coverage of the optimal solution.
+ *
+ * The optimal solution has at most kA nodes, so its coverage is at most the current coverage plus the kA
+ * largest marginal coverages. The bound is evaluated at steps 0, 1, 2, 4, 8, ... and at the end.
+ * @param graph : the graph
+ * @param R : the RI sets
+ * @param A : active participant set
+ * @param k : the number in the problem definition
+ * @param kA : maximum size of a feasible seed set
+ * @param S : returns S as an passed parameter
+ * @param limit : only use the first `limit` RI sets of R, -1 for all
+ * @return : the upper bound of coverage of the optimal solution in these RI sets
+ */
+int64 OPIMNodeSelection_advanced(Graph &graph, RRcollection &R, vector<node> &A, int32 k, int64 kA,
+                                 vector<node> &S, int64 limit = -1) {
+    phase_timer timer(PHASE_NODE_SELECTION);
+    S.clear();
+    bool all = limit < 0 || limit >= R.sets.size();
+    if (all) limit = (int64) R.sets.size();
+    ParticipantIndex &index = participant_index(graph, A);
+    ParticipantQuota quota(index, k);
+    vector<node> &N = index.candidates; //candidate neighbour set
+    vector<bool> &nodeRemain = ctx().nodeRemain;
+    vector<int64> &coveredNum_tmp = ctx().coveredNum_tmp;
+    vector<bool> RIsetCovered(limit, false);
+    for (node i : N) nodeRemain[i] = true, coveredNum_tmp[i] = all ? R.coveredNum[i] : R.covered_in(i, limit);
+    vector<int64> top;
+    int64 influence = 0, upper = INT64_MAX, next_check = 0;
+    auto update_upper = [&]() {
+        top.clear();
+        for (node i : N) if (nodeRemain[i]) top.emplace_back(coveredNum_tmp[i]);
+        int64 kk = min(kA, (int64) top.size()), sum = influence;
+        nth_element(top.begin(), top.begin() + kk, top.end(), greater<int64>());
+        for (int64 i = 0; i < kk; i++) sum += top[i];
+        upper = min(upper, sum);
+        next_check = max((int64) 1, 2 * (int64) S.size());
+    };
+    priority_queue<pair<int64, node>> Q;
+    for (node i : N) Q.push(make_pair(coveredNum_tmp[i], i));
+    profile_count(COUNTER_HEAP_PUSHES, (int64) Q.size());
+    update_upper();
+    while (!Q.empty()) {
+        int64 value = Q.top().first;
+        node maxInd = Q.top().second;
+        Q.pop();
+
+        if (!quota.available(maxInd)) continue;
+
+        if (value > coveredNum_tmp[maxInd]) {
+            Q.push(make_pair(coveredNum_tmp[maxInd], maxInd));
+            profile_count(COUNTER_HEAP_PUSHES);
+            continue;
+        }
+        influence += coveredNum_tmp[maxInd];
+        S.emplace_back(maxInd);
+        quota.take(maxInd);
+        nodeRemain[maxInd] = false;
+        for (int64 RIIndex : R.covered[maxInd]) {
+            if (RIIndex >= limit) break;
+            if (RIsetCovered[RIIndex]) continue;
+            for (node u : R.sets[RIIndex]) {
+                if (nodeRemain[u]) coveredNum_tmp[u]--;
+            }
+            RIsetCovered[RIIndex] = true;
+        }
+        if (S.size() == next_check) update_upper();
+    }
+    update_upper();
+    for (node i : N) nodeRemain[i] = false;
+    return upper;
+}
+
+/*!
+ * @brief Anytime version of advanced IMM. As in anytime_IMM, round i only uses the first theta_i sets of R1 and R2.
+ * @param graph : the graph
+ * @param A : active participant set
+ * @param k : the number in the problem definition
+ * @param eps : argument related to accuracy.
+ * @param delta : failure probability.
+ * @param deadline : the deadline
+ * @param S : returns the best seed set
+ * @return : the certified approximation ratio of S
+ */
+double anytime_IMM_advanced(Graph &graph, vector<node> &A, int32 k, double eps, double delta, time_point deadline,
+                            vector<node> &S) {
+    S.clear();
+    Context &c = ctx();
+    c.fit(graph);
+    RRcollection &R1_opim = c.R1_opim, &R2_opim = c.R2_opim;
+    int32 kA = 0;
+    for (node u : A) kA += min(k, (int32) graph.g[u].size());
+    kA = max(1, min(kA, (int32) graph.n));
+    double e = exp(1), approx = 1.0 - 1.0 / e;
+    double theta_max = 2.0 * graph.n *
+                       Math::sqr(approx * sqrt(log(6.0 / delta)) +
+                                 sqrt(approx * (Math::logcnk(graph.n, kA) + log(6.0 / delta)))) /
+                       Math::sqr(eps) / kA;
+    double theta_0 = theta_max * Math::sqr(eps) * kA / graph.n;
+    auto i_max = (int32) ceil(log2(max(2.0, theta_max / theta_0)));
+    double a = log(3.0 * i_max / delta), best_ratio = -1;
+    vector<node> S_tmp;
+    for (int32 i = 1; i <= i_max; i++) {
+        auto theta = (int64) ceil(theta_0 * pow(2.0, i - 1));
+        bool in_time = R1_opim.fill(graph, theta, deadline, c.engine, c.ws);
+        in_time = R2_opim.fill(graph, theta, deadline, c.engine, c.ws) && in_time;
+        if (!in_time && best_ratio >= 0) break;
+        auto theta1 = min(theta, (int64) R1_opim.sets.size()), theta2 = min(theta, (int64) R2_opim.sets.size());
+        double upper_cov = OPIMNodeSelection_advanced(graph, R1_opim, A, k, kA, S_tmp, theta1);
+        double ratio = theta2 == 0 ? 0 : spread_lower_bound(R2_opim.coverage(S_tmp, theta2), theta2, graph.n, a) /
+                                         spread_upper_bound(upper_cov, theta1, graph.n, a);
+        if (ratio > best_ratio) best_ratio = ratio, S = S_tmp;
+        c.anytime_RR_used = theta1 + theta2;
+        if (verbose_flag) {
+            cout << "\ti = " << i << " |R1| = " << theta1 << " ratio = " << ratio << endl;
+        }
+        if (!in_time || best_ratio >= approx - eps) break;
+    }
+    return best_ratio;
+}
+
+/*!
+ * @brief Encapsulated operations for advanced version of IM solver : IMM with a wall-clock budget
+ * @param graph : the graph
+ * @param k : the number in the problem definition
+ * @param A : the active participant set A
+ * @param seeds : returns the seed set S = {S_1, S_2, ..., S_n}
+ */
+void anytime_advanced_IMM_method(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds) {
+    double cur = wall_clock();
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(time_budget));
+    ctx().OPIM_ratio = anytime_IMM_advanced(graph, A, k, 0.5, 1.0 / graph.n, deadline, seeds);
+    if (verbose_flag) printf("anytime IMM advanced done. total time = %.3f\n", time_by(cur));
+}
+
+#endif //EXP_OPIM_H
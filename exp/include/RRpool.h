@@ -0,0 +1,410 @@
+// RR pool for pipelined IMM : segments sampled in parallel and merged in order by one consumer
+
+#ifndef EXP_RRPOOL_H
+#define EXP_RRPOOL_H
+
+#include "graph.h"
+#include "threadpool.h"
+#include <queue>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
+
+/*!
+ * @brief Temporary arrays and random engine of RI_Gen, one for each sampling thread.
+ *
+ * dist : all -1 between two calls
+ * vis : all false between two calls
+ */
+struct RI_workspace {
+    vector<int64> dist;
+    vector<bool> vis;
+    std::minstd_rand engine;
+
+    RI_workspace() : engine(rd__()) {}
+
+    void resize(node n) {
+        if (dist.size() >= n) return;
+        dist.assign(n, -1);
+        vis.assign(n, false);
+    }
+};
+
+/*!
+ * @brief The temporary arrays of the calling thread for the RI sets sampled in parallel loops.
+ */
+RI_workspace &thread_workspace() {
+    static thread_local RI_workspace ws;
+    return ws;
+}
+
+/*!
+ * @brief The kernel of RI_Gen that works on the given temporary arrays and random engine.
+ * @param graph : the graph
+ * @param uStart : the starting nodes of this RI/FI set
+ * @param RR : returns the RI/FI set as an passed parameter
+ * @param RI_flag : determine which type of set to generate. true as RI, false as FI.
+ * @param dist : distance array, all -1 on entry and restored on exit
+ * @param vis : visited array, all false on entry and restored on exit
+ * @param engine : the random engine
+ */
+template<class Dist, class Vis>
+void RI_Gen_kernel(Graph &graph, vector<node> &uStart, vector<node> &RR, bool RI_flag,
+                   Dist &dist, Vis &vis, std::minstd_rand &engine) {
+    std::uniform_real_distribution<double> real_distrib(0.0, 1.0);
+    auto *edge_list = RI_flag ? &graph.gT : &graph.g;
+    for (node u : uStart)
+        dist[u] = 0;
+    RR.clear();
+    priority_queue<pair<int64, node>> Q;
+    int64 examined = 0;
+    for (node u : uStart)
+        Q.push(make_pair(0, u));
+    while (!Q.empty()) { //Dijkstra Algorithm
+        node u = Q.top().second;
+        Q.pop();
+        if (vis[u]) continue;
+        vis[u] = true;
+        RR.emplace_back(u);
+        examined += (int64) (*edge_list)[u].size();
+        for (auto &edgeT : (*edge_list)[u]) {
+            bool activate_success = (real_distrib(engine) < edgeT.p);
+            if (activate_success) {
+                int randomWeight;
+                if (graph.diff_model == IC) {
+                    randomWeight = 1;
+                } else if (graph.diff_model == IC_M) {
+                    geometric_distribution<int> distribution(edgeT.m);
+                    randomWeight = distribution(engine) + 1;
+                }
+                if ((dist[edgeT.v] == -1 || dist[edgeT.v] > dist[u] + randomWeight) &&
+                    dist[u] + randomWeight <= graph.deadline) {
+                    dist[edgeT.v] = dist[u] + randomWeight;
+                    Q.push(make_pair(-dist[edgeT.v], edgeT.v));
+                }
+            }
+
+        }
+    }
+    for (node u : RR)
+        dist[u] = -1, vis[u] = false;
+    profile_count(COUNTER_EDGES, examined);
+}
+
+/*!
+ * @brief Sample an RI set from a random root, with the random engine in the given state.
+ *
+ * The root and the traversal only draw from this engine, so the same state on the same graph gives the same set.
+ * The traversal only reads the in-edges of the nodes of the set, so the set stays valid after a change of the
+ * graph that does not touch the in-edges of any of its nodes.
+ * @param graph : the graph
+ * @param engine : the random engine, in the state the set is sampled from
+ * @param RR : returns the RI set
+ * @param ws : the temporary arrays, its engine is not used
+ */
+void RI_sample(Graph &graph, std::minstd_rand &engine, vector<node> &RR, RI_workspace &ws) {
+    uniform_int_distribution<node> uniformIntDistribution(0, graph.n - 1);
+    vector<node> vStart = {uniformIntDistribution(engine)};
+    RI_Gen_kernel(graph, vStart, RR, true, ws.dist, ws.vis, engine);
+}
+
+/*!
+ * @brief Bring a collection of RI sets up to date with a change of the graph (see Graph::update_edges).
+ *
+ * Every set is kept with the state of the random engine it is sampled from. The sets that contain a dirty node
+ * are found by the inverted index and sampled again from the same state on the thread pool, the others are
+ * unchanged. The result is exactly what sampling every set again from its state would give, so the collection
+ * is still a sample of independent RI sets of the new graph. n must not have changed.
+ * @param graph : the graph after the change
+ * @param sets : the RI sets
+ * @param states : states[i] is the state of the random engine that sets[i] is sampled from
+ * @param covered : covered[u] lists the sets that contain u in increasing order, which is kept
+ * @param coveredNum : coveredNum[u] is the length of covered[u]
+ * @param dirty : the nodes whose in-edges have changed
+ * @return : number of sets sampled again
+ */
+template<class Covered, class CoveredNum>
+int64 refresh_RR_sets(Graph &graph, vector<vector<node>> &sets, const vector<std::minstd_rand> &states,
+                      Covered &covered, CoveredNum &coveredNum, const vector<node> &dirty) {
+    vector<bool> stale(sets.size(), false), touched(graph.n, false);
+    vector<int64> ids;
+    for (node u : dirty)
+        for (int64 i : covered[u])
+            if (!stale[i]) stale[i] = true, ids.emplace_back(i);
+    vector<node> nodes;
+    for (int64 i : ids)
+        for (node u : sets[i]) {
+            coveredNum[u]--;
+            if (!touched[u]) touched[u] = true, nodes.emplace_back(u);
+        }
+    for (node u : nodes) {
+        auto &list = covered[u];
+        list.erase(remove_if(list.begin(), list.end(), [&](int64 i) { return stale[i]; }), list.end());
+    }
+    thread_pool().parallel_for((int64) ids.size(), [&](int32 tid, int64 j) {
+        RI_workspace &ws = thread_workspace();
+        ws.resize(graph.n);
+        std::minstd_rand engine = states[ids[j]];
+        RI_sample(graph, engine, sets[ids[j]], ws);
+    });
+    for (node u : nodes) touched[u] = false;
+    nodes.clear();
+    for (int64 i : ids)
+        for (node u : sets[i]) {
+            covered[u].emplace_back(i);
+            coveredNum[u]++;
+            if (!touched[u]) touched[u] = true, nodes.emplace_back(u);
+        }
+    for (node u : nodes) sort(covered[u].begin(), covered[u].end());
+    return (int64) ids.size();
+}
+
+/*!
+ * @brief A set of RI sets together with its own inverted index.
+ */
+struct RRcollection {
+    vector<vector<node>> sets;
+    ///states[i] is the state of the random engine that sets[i] is sampled from, see refresh_RR_sets
+    vector<std::minstd_rand> states;
+    ///covered[u] marks which RI sets the node u is covered by, in increasing order
+    vector<vector<int64>> covered;
+    ///coveredNum[u] marks how many RI sets the node u is covered by
+    vector<int64> coveredNum;
+
+    void init(node n) {
+        sets.clear();
+        states.clear();
+        covered.assign(n, vector<int64>());
+        coveredNum.assign(n, 0);
+    }
+
+    void push(vector<node> &RR, const std::minstd_rand &state) {
+        sets.emplace_back(RR);
+        states.emplace_back(state);
+        for (node u : RR) {
+            covered[u].emplace_back(sets.size() - 1);
+            coveredNum[u]++;
+        }
+    }
+
+    /*!
+     * @brief generate random RI sets until there are at least `num` of them or the deadline has passed.
+     * At least one RI set is always generated into an empty collection.
+     * @param graph : the graph
+     * @param num : the required size
+     * @param deadline : the deadline
+     * @param engine : the random engine
+     * @param ws : the temporary arrays
+     * @return : true if the required size is reached
+     */
+    bool fill(Graph &graph, int64 num, std::chrono::steady_clock::time_point deadline, std::minstd_rand &engine,
+              RI_workspace &ws) {
+        phase_timer timer(PHASE_RR_SAMPLING);
+        vector<node> RR;
+        ws.resize(graph.n);
+        auto before = (int64) sets.size();
+        bool in_time = true;
+        while (sets.size() < num) {
+            if (!sets.empty() && sets.size() % 256 == 0 && std::chrono::steady_clock::now() > deadline) {
+                in_time = false;
+                break;
+            }
+            std::minstd_rand state = engine;
+            RI_sample(graph, engine, RR, ws);
+            push(RR, state);
+        }
+        profile_count(COUNTER_RR_SETS, (int64) sets.size() - before);
+        return in_time;
+    }
+
+    /// the number of the first `limit` RI sets that contain u
+    int64 covered_in(node u, int64 limit) const {
+        return lower_bound(covered[u].begin(), covered[u].end(), limit) - covered[u].begin();
+    }
+
+    /*!
+     * @brief Count the RI sets that intersect with S.
+     * @param S : the node set
+     * @param limit : only count the first `limit` RI sets, -1 for all
+     * @return : number of covered RI sets
+     */
+    int64 coverage(vector<node> &S, int64 limit = -1) {
+        if (limit < 0 || limit > sets.size()) limit = (int64) sets.size();
+        vector<bool> setCovered(limit, false);
+        int64 res = 0;
+        for (node u : S)
+            for (int64 RIIndex : covered[u]) {
+                if (RIIndex >= limit) break;
+                if (!setCovered[RIIndex]) setCovered[RIIndex] = true, res++;
+            }
+        return res;
+    }
+};
+
+/*!
+ * @brief A pool of RI sets filled by sampler threads and drained by a single consumer.
+ *
+ * The pool is an array of fixed-size segments. A sampler claims the next segment index with an atomic counter,
+ * fills the segment privately and then seals it by publishing its pointer. The consumer merges sealed segments
+ * in index order, so the merged prefix is always a sequence of independent RI sets. Samplers only claim
+ * segments below the current target, which the consumer may raise at any time. The samplers that wait for the
+ * target and the consumer that waits for a segment sleep on condition variables.
+ */
+class RRpool {
+public:
+    /// RI sets of a segment in flat form : set i is nodes[offsets[i], offsets[i + 1]), sampled from states[i]
+    struct Segment {
+        vector<node> nodes;
+        vector<int64> offsets;
+        vector<std::minstd_rand> states;
+    };
+
+    /*!
+     * @param graph : the graph
+     * @param threads : number of sampler threads
+     * @param capacity : maximum number of RI sets that can be sampled by this pool
+     * @param workspaces : the temporary arrays of the samplers, kept by the caller between pools since they are
+     * as large as the graph
+     * @param segment_size : number of RI sets in a segment
+     */
+    RRpool(Graph &graph, int32 threads, int64 capacity, vector<RI_workspace> &workspaces, int64 segment_size = 256)
+            : graph(graph), workspaces(workspaces), context(current_context()), segment_size(segment_size),
+              max_segments(capacity / segment_size + 1),
+              slots(new std::atomic<Segment *>[capacity / segment_size + 1]) {
+        for (int64 i = 0; i < max_segments; i++) slots[i].store(nullptr, std::memory_order_relaxed);
+        next_segment = 0, merge_segment = 0, target = 0, stopped = false;
+        if (workspaces.size() < threads) workspaces.resize(threads);
+        for (int32 t = 0; t < threads; t++) {
+            workspaces[t].resize(graph.n);
+            samplers.emplace_back(&RRpool::sampler, this, t);
+        }
+    }
+
+    ~RRpool() {
+        stop();
+        for (int64 i = merge_segment; i < max_segments; i++) delete slots[i].load();
+    }
+
+    /*!
+     * @brief Raise the number of RI sets that samplers should produce. It never decreases.
+     * @param new_target : the new target
+     */
+    void set_target(int64 new_target) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (new_target <= target.load()) return;
+            target = new_target;
+        }
+        cv_target.notify_all();
+    }
+
+    /*!
+     * @brief Block until at least `num` RI sets of the pool have been merged into the given containers.
+     * @param num : number of RI sets required, at most the capacity of the pool
+     * @param insert : callback that receives each RI set and the state of the engine it is sampled from, in order
+     * @return : false if the pool has been stopped before `num` RI sets are merged
+     */
+    template<class Insert>
+    bool consume(int64 num, Insert insert) {
+        num = min(num, max_segments * segment_size);
+        set_target(num);
+        while (merged < num) {
+            if (merge_next(insert)) continue;
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_sealed.wait(lock, [&]() {
+                return stopped || slots[merge_segment].load(std::memory_order_acquire) != nullptr;
+            });
+            if (stopped && slots[merge_segment].load(std::memory_order_acquire) == nullptr) return false;
+        }
+        return true;
+    }
+
+    /*!
+     * @brief Stop and join all samplers, then merge the sealed prefix that has not been consumed yet.
+     * @param insert : callback that receives each RI set and the state of the engine it is sampled from, in order
+     */
+    template<class Insert>
+    void stop(Insert insert) {
+        stop();
+        while (merge_next(insert));
+    }
+
+    /// number of RI sets merged so far
+    int64 merged = 0;
+
+private:
+    Graph &graph;
+    vector<RI_workspace> &workspaces;
+    ///the samplers count in the solver context of the thread that made the pool
+    Context *context;
+    const int64 segment_size, max_segments;
+    std::unique_ptr<std::atomic<Segment *>[]> slots;
+    std::atomic<int64> next_segment, target;
+    std::atomic<bool> stopped;
+    int64 merge_segment;
+    vector<std::thread> samplers;
+    ///cv_target : the samplers wait for the target, cv_sealed : the consumer waits for the next segment
+    std::mutex mtx;
+    std::condition_variable cv_target, cv_sealed;
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopped = true;
+        }
+        cv_target.notify_all(), cv_sealed.notify_all();
+        for (auto &t : samplers) if (t.joinable()) t.join();
+    }
+
+    template<class Insert>
+    bool merge_next(Insert insert) {
+        if (merge_segment >= max_segments) return false;
+        Segment *seg = slots[merge_segment].load(std::memory_order_acquire);
+        if (seg == nullptr) return false;
+        vector<node> RR;
+        for (int64 i = 0; i + 1 < seg->offsets.size(); i++) {
+            RR.assign(seg->nodes.begin() + seg->offsets[i], seg->nodes.begin() + seg->offsets[i + 1]);
+            insert(RR, seg->states[i]);
+        }
+        merged += (int64) seg->offsets.size() - 1;
+        delete seg;
+        slots[merge_segment++].store(nullptr, std::memory_order_relaxed);
+        return true;
+    }
+
+    void sampler(int32 tid) {
+        RI_workspace &ws = workspaces[tid];
+        vector<node> RR;
+        current_context() = context, current_phase() = PHASE_RR_SAMPLING;
+        perf_scope counters(PHASE_RR_SAMPLING);
+        while (!stopped) {
+            int64 id = next_segment.fetch_add(1);
+            if (id >= max_segments) return;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_target.wait(lock, [&]() { return stopped || id * segment_size < target.load(); });
+            }
+            if (stopped) return;
+            auto *seg = new Segment;
+            seg->offsets.emplace_back(0);
+            for (int64 i = 0; i < segment_size; i++) {
+                seg->states.emplace_back(ws.engine);
+                RI_sample(graph, ws.engine, RR, ws);
+                seg->nodes.insert(seg->nodes.end(), RR.begin(), RR.end());
+                seg->offsets.emplace_back(seg->nodes.size());
+            }
+            profile_count(COUNTER_RR_SETS, segment_size);
+            {
+                //under the lock, so the consumer cannot miss the wake-up between its check and its wait
+                std::lock_guard<std::mutex> lock(mtx);
+                slots[id].store(seg, std::memory_order_release);
+            }
+            cv_sealed.notify_one();
+        }
+    }
+};
+
+#endif //EXP_RRPOOL_H
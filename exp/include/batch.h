@@ -0,0 +1,178 @@
+// Batch mode : many participant sets against the same graph
+
+#ifndef EXP_BATCH_H
+#define EXP_BATCH_H
+
+#include "server.h"
+
+/*!
+ * @brief Solves many queries on the thread pool with the resources that do not depend on A.
+ *
+ * The pagerank vector and a selection pool of RI sets with its inverted index are built once, and the coverage
+ * of every candidate of every query is read from the index instead of being counted per query. DEGREE_ADVANCED,
+ * PAGERANK_ADVANCED and IMM_ADVANCED only keep per-query state and run in parallel, one query per thread. IMM_ADVANCED
+ * runs the greedy max coverage of IMM on the shared pool, with lazy updates instead of decrementing the counts.
+ * The other solvers run in a single-threaded solver context of the pool thread, so they also run in parallel.
+ */
+class BatchSolver {
+public:
+    BatchSolver(Graph &graph) : graph(graph) {
+        double cur = wall_clock();
+        pagerank(graph, 0.2);
+        pool.build(graph, batch_RR_sets);
+        pool.build_index();
+        workspaces.resize(thread_pool().size());
+        for (int32 t = 0; t < thread_pool().size(); t++) contexts.emplace_back(new Context(1, std::cout, discard));
+        if (verbose_flag) printf("\tbatch resources ready. time = %.3f\n", time_by(cur));
+    }
+
+    /*!
+     * @brief Solve one query.
+     * @param q : the query
+     * @param seeds : returns the seeds
+     * @param tid : the thread id in the pool
+     */
+    void solve(const bim_query &q, vector<node> &seeds, int32 tid) {
+        seeds.clear();
+        vector<node> A = q.A;
+        if (q.solver != DEGREE_ADVANCED && q.solver != PAGERANK_ADVANCED && q.solver != IMM_ADVANCED) {
+            context_scope scope(*contexts[tid]);
+            contexts[tid]->spread_estimator = solver_estimator[q.solver];
+            switch (q.solver) {
+                case ENUMERATION: enumeration_method(graph, q.k, A, seeds); break;
+                case DEGREE: degree_method(graph, q.k, A, seeds); break;
+                case PAGERANK: pgrank_method(graph, q.k, A, seeds); break;
+                case CELF_NORMAL: CELF_method(graph, q.k, A, seeds); break;
+                case CELF_ADVANCED: advanced_CELF_method(graph, q.k, A, seeds); break;
+                case IMM_NORMAL: IMM_method(graph, q.k, A, seeds); break;
+                case OPIM_NORMAL: OPIM_method(graph, q.k, A, seeds); break;
+                case LOCAL_PPR: local_ppr_method(graph, q.k, A, seeds); break;
+                default: break;
+            }
+            return;
+        }
+        ParticipantIndex index(graph, A);
+        ParticipantQuota quota(index, q.k);
+        if (q.solver == IMM_ADVANCED) {
+            coverage_greedy(index, quota, seeds, workspaces[tid]);
+            return;
+        }
+        auto snapshot = pagerank(graph, 0.2);
+        const vector<double> &pi = *snapshot;
+        vector<pair<double, node> > S_ordered;
+        for (node w : index.candidates)
+            S_ordered.emplace_back(make_pair(q.solver == DEGREE_ADVANCED ? graph.deg_out[w] : pi[w], w));
+        sort(S_ordered.begin(), S_ordered.end());
+        reverse(S_ordered.begin(), S_ordered.end());
+        for (auto &x : S_ordered) {
+            if (!quota.available(x.second)) continue;
+            quota.take(x.second);
+            seeds.emplace_back(x.second);
+        }
+    }
+
+private:
+    /// covered[i] : the i-th RI set is covered by the seeds of the current query, all false between two queries
+    struct Workspace {
+        vector<bool> covered;
+        vector<uint32_t> touched;
+    };
+
+    Graph &graph;
+    RREvaluator pool;
+    vector<Workspace> workspaces;
+    ///contexts[tid] is used by the thread tid of the pool, the result file is not written in this mode
+    std::ostream discard{nullptr};
+    vector<std::unique_ptr<Context>> contexts;
+
+    void coverage_greedy(ParticipantIndex &index, ParticipantQuota &quota, vector<node> &seeds, Workspace &ws) {
+        if (ws.covered.size() < pool.size()) ws.covered.assign(pool.size(), false);
+        priority_queue<pair<int64, node>> Q;
+        for (node v : index.candidates) Q.push(make_pair(pool.coverage(v), v));
+        while (!Q.empty()) {
+            node v = Q.top().second;
+            int64 value = Q.top().first;
+            Q.pop();
+            if (!quota.available(v)) continue;
+            int64 gain = 0;
+            for (const uint32_t *i = pool.sets_begin(v); i != pool.sets_end(v); i++) gain += !ws.covered[*i];
+            if (gain < value) {
+                Q.push(make_pair(gain, v));
+                continue;
+            }
+            seeds.emplace_back(v);
+            quota.take(v);
+            for (const uint32_t *i = pool.sets_begin(v); i != pool.sets_end(v); i++)
+                if (!ws.covered[*i]) ws.covered[*i] = true, ws.touched.emplace_back(*i);
+        }
+        for (uint32_t i : ws.touched) ws.covered[i] = false;
+        ws.touched.clear();
+    }
+};
+
+/*!
+ * @brief --batch mode : solve the queries of a file, one query line per line (see parse_query).
+ *
+ * The queries are solved in waves of 64 on the thread pool. The seeds of a wave are evaluated in one pass over
+ * the evaluation pool, and the replies of the wave are appended to the output file as soon as it is done.
+ * @param type : the diffusion model
+ */
+void Batch(model_type type) {
+    Graph G(graphFilePath, DIRECTED_G);
+    G.set_diffusion_model(type, 15);
+    ifstream inFile(batch_path, ios::in);
+    if (!inFile.is_open()) {
+        std::cerr << "(get error) batch file not found: " << batch_path << std::endl;
+        std::exit(-1);
+    }
+    ofstream outFile(batch_output_path, ios::out | ios::trunc);
+    if (!outFile.is_open()) {
+        std::cerr << "(get error) cannot write batch output: " << batch_output_path << std::endl;
+        std::exit(-1);
+    }
+    vector<string> lines;
+    string line;
+    while (getline(inFile, line))
+        if (!line.empty()) lines.emplace_back(line);
+    inFile.close();
+    double cur = wall_clock();
+    BatchSolver solver(G);
+    RREvaluator &evaluator = rr_evaluator_of(G);
+    cout << "batch resources ready. queries = " << lines.size() << ", time = " << time_by(cur) << endl;
+    cur = wall_clock();
+    const int64 wave = 64;
+    int64 done = 0, failed = 0;
+    for (int64 first = 0; first < lines.size(); first += wave) {
+        int64 num = min(wave, (int64) lines.size() - first);
+        vector<bim_query> q(num);
+        vector<string> err(num);
+        vector<char> ok(num);
+        vector<vector<node>> seeds(num);
+        vector<double> solve_time(num);
+        thread_pool().parallel_for(num, [&](int32 tid, int64 i) {
+            json_object req;
+            ok[i] = parse_query(lines[first + i], G, q[i], req, err[i]);
+            if (!ok[i]) return;
+            double t = wall_clock();
+            solver.solve(q[i], seeds[i], tid);
+            solve_time[i] = time_by(t);
+        });
+        double t = wall_clock();
+        vector<spread_estimate> est = evaluator.evaluate(seeds);
+        double eval_time = time_by(t) / num;
+        for (int64 i = 0; i < num; i++) {
+            if (ok[i]) outFile << query_reply(q[i], seeds[i], est[i], solve_time[i], eval_time) << '\n';
+            else outFile << query_error(q[i].id, err[i]) << '\n', failed++;
+        }
+        outFile.flush();
+        done += num;
+        if (verbose_flag) printf("\t%ld / %ld queries done, %.1f queries/s\n", (long) done, (long) lines.size(),
+                                 done / max(time_by(cur), 1e-9));
+    }
+    outFile.close();
+    double total = time_by(cur);
+    cout << "batch done. queries = " << done << ", failed = " << failed << ", time = " << total
+         << ", throughput = " << done / max(total, 1e-9) << " queries/s, output = " << batch_output_path << endl;
+}
+
+#endif //EXP_BATCH_H
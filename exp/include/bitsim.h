@@ -0,0 +1,170 @@
+// Bit-parallel MC simulation : 64 cascades per pass
+
+#ifndef EXP_BITSIM_H
+#define EXP_BITSIM_H
+
+#include "graph.h"
+
+/*!
+ * @brief splitmix64 generator, used for 64 coin flips at a time.
+ */
+struct rng64 {
+    uint64_t state;
+
+    explicit rng64(uint64_t seed = 0) : state(seed) {}
+
+    inline uint64_t operator()() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+/*!
+ * @brief Flip a coin with probability p independently for every lane in `lanes`.
+ *
+ * Each lane compares a random number u with p bit by bit from the most significant bit, and the lanes
+ * with a decided comparison drop out, so about log2(popcount(lanes)) + 2 random words are used.
+ * A single lane uses one random word.
+ * @param p : success probability
+ * @param lanes : the lanes that flip a coin
+ * @param rng : the random generator
+ * @return the lanes that succeed
+ */
+inline uint64_t bernoulli_mask(double p, uint64_t lanes, rng64 &rng) {
+    if (p <= 0.0 || !lanes) return 0;
+    double scaled = p * 18446744073709551616.0;
+    if (scaled >= 18446744073709551615.0) return lanes;
+    auto p_bits = (uint64_t) scaled;
+    uint64_t res = 0;
+    if (!(lanes & (lanes - 1))) return rng() < p_bits ? lanes : 0;
+    for (int b = 63; b >= 0 && lanes; b--) {
+        uint64_t r = rng();
+        if ((p_bits >> b) & 1) {
+            res |= lanes & ~r;
+            lanes &= r;
+        } else lanes &= ~r;
+    }
+    return res;
+}
+
+/*!
+ * @brief Per-node masks and buffers of the bit-parallel simulation.
+ *
+ * act[v] : the worlds in which v is active
+ * fresh[v] : the worlds in which v has just been activated and is not expanded yet
+ * touched : the nodes with non-zero act[], used to reset act[] after a pass
+ * buckets[t] : (v, worlds) whose meeting succeeds at the end of round t-1 (IC-M only)
+ */
+struct BP_state {
+    vector<uint64_t> act, fresh;
+    vector<node> touched, frontier, next_frontier;
+    vector<vector<pair<node, uint64_t>>> buckets;
+    rng64 rng;
+
+    BP_state() : rng(((uint64_t) rd__() << 32) ^ rd__()) {}
+
+    void resize(node n) {
+        if (act.size() >= n) return;
+        act.assign(n, 0);
+        fresh.assign(n, 0);
+    }
+
+    inline void activate(node v, uint64_t worlds) {
+        if (!act[v]) touched.emplace_back(v);
+        act[v] |= worlds;
+        if (!fresh[v]) next_frontier.emplace_back(v);
+        fresh[v] |= worlds;
+    }
+};
+
+/*!
+ * @brief Sample the out-going meetings of node u in IC-M, which is activated at round t in the given worlds.
+ * @param graph : the graph
+ * @param u : the node
+ * @param worlds : the worlds in which u is activated at round t
+ * @param t : the round
+ * @param st : the state
+ */
+inline void BP_expand_ICM(Graph &graph, node u, uint64_t worlds, int64 t, BP_state &st) {
+    for (auto &edge : graph.g[u]) {
+        uint64_t pending = worlds & ~st.act[edge.v];
+        for (int64 r = t; r < graph.deadline && pending; r++) {
+            uint64_t met = bernoulli_mask(edge.m, pending, st.rng);
+            if (!met) continue;
+            pending &= ~met;
+            uint64_t success = bernoulli_mask(edge.p, met, st.rng);
+            if (success) st.buckets[r + 1].emplace_back(edge.v, success);
+        }
+    }
+}
+
+/*!
+ * @brief Run one pass of 64 (or fewer) cascades from S.
+ * @param graph : the graph that define propagation models(IC or IC-M)
+ * @param S : the seed set
+ * @param worlds : the lanes to simulate
+ * @param st : the state
+ * @param sumsq : if not null, returns the sum of squared numbers of active nodes of the worlds
+ * @return the total number of active nodes over all simulated worlds
+ */
+int64 BP_pass(Graph &graph, vector<node> &S, uint64_t worlds, BP_state &st, int64 *sumsq = nullptr) {
+    st.resize(graph.n);
+    st.touched.clear(), st.frontier.clear(), st.next_frontier.clear();
+    for (node w : S) st.activate(w, worlds);
+    int64 edges = 0;
+    if (graph.diff_model == IC) {
+        while (!st.next_frontier.empty()) {
+            st.frontier.swap(st.next_frontier);
+            st.next_frontier.clear();
+            for (node u : st.frontier) {
+                uint64_t m = st.fresh[u];
+                st.fresh[u] = 0;
+                edges += (int64) graph.g[u].size();
+                for (auto &edge : graph.g[u]) {
+                    uint64_t cand = m & ~st.act[edge.v];
+                    if (!cand) continue;
+                    uint64_t success = bernoulli_mask(edge.p, cand, st.rng);
+                    if (success) st.activate(edge.v, success);
+                }
+            }
+        }
+    } else if (graph.diff_model == IC_M) {
+        if (st.buckets.size() < graph.deadline + 1) st.buckets.resize(graph.deadline + 1);
+        for (int64 t = 0; t <= graph.deadline; t++) {
+            if (t > 0) {
+                for (auto &e : st.buckets[t]) {
+                    uint64_t newly = e.second & ~st.act[e.first];
+                    if (newly) st.activate(e.first, newly);
+                }
+                st.buckets[t].clear();
+            }
+            if (t == graph.deadline) break;
+            st.frontier.swap(st.next_frontier);
+            st.next_frontier.clear();
+            for (node u : st.frontier) {
+                uint64_t m = st.fresh[u];
+                st.fresh[u] = 0;
+                edges += (int64) graph.g[u].size();
+                BP_expand_ICM(graph, u, m, t, st);
+            }
+        }
+    }
+    for (node u : st.next_frontier) st.fresh[u] = 0;
+    int64 total = 0, lane_count[64] = {0};
+    for (node u : st.touched) {
+        total += __builtin_popcountll(st.act[u]);
+        if (sumsq)
+            for (uint64_t w = st.act[u]; w; w &= w - 1) lane_count[__builtin_ctzll(w)]++;
+        st.act[u] = 0;
+    }
+    if (sumsq) {
+        *sumsq = 0;
+        for (int64 c : lane_count) *sumsq += c * c;
+    }
+    profile_count(COUNTER_EDGES, edges);
+    return total;
+}
+
+#endif //EXP_BITSIM_H
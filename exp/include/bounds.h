@@ -0,0 +1,126 @@
+// Confidence bounds of influence spread from RI sets
+
+#ifndef EXP_BOUNDS_H
+#define EXP_BOUNDS_H
+
+#include "RRpool.h"
+#include "threadpool.h"
+#include <tuple>
+
+/*!
+ * @brief Lower confidence bound of sigma(S) from its coverage in an independent set of RI sets.
+ * @param cov : number of RI sets covered by S
+ * @param theta : number of RI sets
+ * @param n : number of nodes
+ * @param a : log(1/failure probability)
+ */
+double spread_lower_bound(double cov, int64 theta, node n, double a) {
+    return (pow(sqrt(cov + 2.0 * a / 9) - sqrt(a / 2), 2) - a / 18) * n / theta;
+}
+
+/*!
+ * @brief Upper confidence bound of sigma(S) from an upper bound of its coverage.
+ * @param cov : upper bound of number of RI sets covered by S
+ * @param theta : number of RI sets
+ * @param n : number of nodes
+ * @param a : log(1/failure probability)
+ */
+double spread_upper_bound(double cov, int64 theta, node n, double a) {
+    return pow(sqrt(cov + a / 2) + sqrt(a / 2), 2) * n / theta;
+}
+
+/*!
+ * @brief Count how many of theta independent random RI sets cover each node.
+ *
+ * The RI sets are generated on the thread pool and not stored.
+ * @param graph : the graph
+ * @param theta : number of RI sets
+ * @return : the coverage of every node
+ */
+vector<int64> singleton_coverage(Graph &graph, int64 theta) {
+    ThreadPool &pool = thread_pool();
+    int64 chunks = (int64) pool.size() * 4;
+    vector<vector<int64>> cnt(pool.size());
+    pool.parallel_for(chunks, [&](int32 tid, int64 c) {
+        RI_workspace &ws = thread_workspace();
+        ws.resize(graph.n);
+        if (cnt[tid].empty()) cnt[tid].assign(graph.n, 0);
+        uniform_int_distribution<node> uniformIntDistribution(0, graph.n - 1);
+        vector<node> RR, vStart(1);
+        for (int64 i = theta * c / chunks; i < theta * (c + 1) / chunks; i++) {
+            vStart[0] = uniformIntDistribution(ws.engine);
+            RI_Gen_kernel(graph, vStart, RR, true, ws.dist, ws.vis, ws.engine);
+            for (node u : RR) cnt[tid][u]++;
+        }
+    });
+    vector<int64> res(graph.n, 0);
+    for (auto &c : cnt)
+        if (!c.empty())
+            for (node u = 0; u < graph.n; u++) res[u] += c[u];
+    return res;
+}
+
+///number of RI sets per node used by singleton_upper_bounds
+int64 singleton_bound_factor = 16;
+
+/*!
+ * @brief Upper bounds of sigma({u}) for all nodes, computed once per graph and diffusion model.
+ *
+ * Each bound is the upper confidence bound from the coverage of u in 16n independent RI sets, with failure
+ * probability 1/n^2. In IC-M, sigma({u}) is also at most the total probability of the walks from u with
+ * at most deadline edges, which is used when smaller.
+ * @param graph : the graph
+ * @param ready : if not null, nothing is computed, and it returns whether the bounds of the graph are computed
+ * @return : the bounds, indexed by node
+ */
+vector<double> &singleton_upper_bounds(Graph &graph, bool *ready = nullptr) {
+    static vector<double> bound;
+    static tuple<const Graph *, node, int64, int64, model_type, int64> key;
+    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock(mtx);
+    auto now = make_tuple((const Graph *) &graph, graph.n, graph.m, graph.version, graph.diff_model, graph.deadline);
+    if (ready) {
+        *ready = now == key && bound.size() == graph.n;
+        return bound;
+    }
+    if (now == key && bound.size() == graph.n) return bound;
+    key = now;
+    double cur = wall_clock();
+    int64 theta = singleton_bound_factor * graph.n;
+    vector<int64> cov = singleton_coverage(graph, theta);
+    double a = 2 * log(graph.n);
+    bound.assign(graph.n, 0);
+    for (node u = 0; u < graph.n; u++) bound[u] = min((double) graph.n, spread_upper_bound(cov[u], theta, graph.n, a));
+    if (graph.diff_model == IC_M) {
+        //y_t(u) = 1 + sum q(u,v) y_{t-1}(v), where q(u,v) is the probability that (u,v) succeeds within the deadline
+        vector<double> y(graph.n, 1), y_next(graph.n);
+        for (int64 t = 0; t < graph.deadline; t++) {
+            for (node u = 0; u < graph.n; u++) {
+                y_next[u] = 1;
+                for (auto &edge : graph.g[u])
+                    y_next[u] += edge.p * (1 - pow(1 - edge.m, (double) graph.deadline)) * y[edge.v];
+            }
+            y.swap(y_next);
+        }
+        for (node u = 0; u < graph.n; u++) bound[u] = min(bound[u], y[u]);
+    }
+    if (verbose_flag) printf("\tsingleton bounds done. RI sets = %ld, time = %.3f\n", (long) theta, time_by(cur));
+    return bound;
+}
+
+/*!
+ * @brief Check if the singleton bounds are worth using for a greedy on the candidates.
+ *
+ * They are used if they are already computed for the graph, or if they cost less than one MC evaluation of every
+ * candidate (16n RI sets against |candidate| * MC_iteration_rounds cascades). Otherwise a greedy on a few
+ * candidates would spend more on the bounds of the whole graph than on the candidates themselves.
+ * @param graph : the graph
+ * @param candidates : number of candidates
+ */
+bool use_singleton_bounds(Graph &graph, int64 candidates) {
+    bool ready;
+    singleton_upper_bounds(graph, &ready);
+    return ready || (double) candidates * MC_iteration_rounds >= (double) singleton_bound_factor * graph.n;
+}
+
+#endif //EXP_BOUNDS_H
@@ -0,0 +1,169 @@
+// Checkpoints of the experiment sweep : participant sets and finished tasks in a shared directory
+
+#ifndef EXP_CHECKPOINT_H
+#define EXP_CHECKPOINT_H
+
+#include "top.h"
+#include <sstream>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*!
+ * @brief The checkpoint of a sweep : one directory with the configuration, the participant sets and one file for
+ * every finished task.
+ *
+ * Every file is written to a temporary name and then moved into place, so a file that exists is complete and a
+ * run that is killed at any time leaves a valid checkpoint. The configuration and the participant sets are only
+ * written if they do not exist yet (by link, which fails if another run was first), so several runs that share
+ * the directory, e.g. the shards of one sweep on different machines, agree on them.
+ */
+class SweepCheckpoint {
+public:
+    /*!
+     * @param dir : the directory, created if it does not exist
+     * @param config : the description of everything that changes the results of the sweep
+     */
+    SweepCheckpoint(const string &dir, const string &config) : dir(dir) {
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) fail("cannot create checkpoint directory");
+        string old;
+        if (!publish("config", config) && (!read_file("config", old) || old != config)) {
+            std::cerr << "(get error) checkpoint " << dir << " was made with another configuration" << std::endl;
+            std::exit(-1);
+        }
+    }
+
+    /*!
+     * @brief Make P the participant sets of the checkpoint : save them if there are none yet, or load them.
+     * @param P : P[a][r] is the participant set of the a-th size in the r-th round
+     */
+    void sync_participants(vector<vector<vector<node>>> &P) {
+        stringstream ss;
+        for (auto &sets : P)
+            for (auto &A : sets) {
+                ss << A.size();
+                for (node u : A) ss << ' ' << u;
+                ss << '\n';
+            }
+        if (publish("participants", ss.str())) return;
+        string text;
+        if (!read_file("participants", text)) fail("cannot read participants");
+        stringstream in(text);
+        for (auto &sets : P)
+            for (auto &A : sets) {
+                int64 size;
+                if (!(in >> size)) fail("bad participants");
+                A.resize(size);
+                for (node &u : A)
+                    if (!(in >> u)) fail("bad participants");
+            }
+    }
+
+    /*!
+     * @brief Load a finished task.
+     * @param id : the task id
+     * @param seeds : returns the seeds
+     * @param time : returns the running time of the solver
+     * @param value : returns the seed quality, -1 if it is evaluated with the shared pool
+     * @return : true if the task is finished
+     */
+    bool load_task(int64 id, vector<node> &seeds, double &time, double &value) {
+        string text;
+        if (!read_file(task_file(id), text)) return false;
+        stringstream in(text);
+        int64 size;
+        if (!(in >> time >> value >> size)) return false;
+        seeds.resize(size);
+        for (node &u : seeds)
+            if (!(in >> u)) return false;
+        return true;
+    }
+
+    void save_task(int64 id, const vector<node> &seeds, double time, double value) {
+        stringstream ss;
+        ss.precision(17);
+        ss << time << ' ' << value << ' ' << seeds.size();
+        for (node u : seeds) ss << ' ' << u;
+        ss << '\n';
+        string tmp = temp_name(task_file(id));
+        write_file(tmp, ss.str());
+        if (rename(tmp.c_str(), (dir + "/" + task_file(id)).c_str()) != 0) fail("cannot write task");
+    }
+
+private:
+    string dir;
+
+    void fail(const string &what) {
+        std::cerr << "(get error) " << what << " in checkpoint " << dir << std::endl;
+        std::exit(-1);
+    }
+
+    static string task_file(int64 id) {
+        return "task_" + to_string(id);
+    }
+
+    string temp_name(const string &name) {
+        char host[256] = {0};
+        gethostname(host, sizeof(host) - 1);
+        return dir + "/." + name + "." + host + "." + to_string(getpid()) + ".tmp";
+    }
+
+    bool read_file(const string &name, string &text) {
+        ifstream in(dir + "/" + name, ios::in | ios::binary);
+        if (!in.is_open()) return false;
+        stringstream ss;
+        ss << in.rdbuf();
+        text = ss.str();
+        return true;
+    }
+
+    void write_file(const string &path, const string &text) {
+        FILE *f = fopen(path.c_str(), "wb");
+        if (f == nullptr || fwrite(text.data(), 1, text.size(), f) != text.size() || fflush(f) != 0 ||
+            fsync(fileno(f)) != 0 || fclose(f) != 0)
+            fail("cannot write " + path);
+    }
+
+    /*!
+     * @brief Create the file name with the text, unless it exists.
+     * @return : true if it is created by this call
+     */
+    bool publish(const string &name, const string &text) {
+        string tmp = temp_name(name);
+        write_file(tmp, text);
+        bool created = link(tmp.c_str(), (dir + "/" + name).c_str()) == 0;
+        unlink(tmp.c_str());
+        return created;
+    }
+};
+
+/*!
+ * @brief The configuration of a sweep that is stored in its checkpoint. The graph and the local file are identified
+ * by their contents and their file names without the directory, so the checkpoint stays valid when the data folder
+ * is moved, and not when a file is regenerated.
+ */
+string sweep_config(Graph &graph, vector<node> &A_batch, vector<int32> &k_batch, vector<IM_solver> &solver_batch,
+                    int32 rounds) {
+    stringstream ss;
+    ss.precision(17);
+    auto file_name = [](const string &path) { return path.substr(path.find_last_of('/') + 1); };
+    ss << "graph " << file_name(graphFilePath) << ' ' << graph.n << ' ' << graph.m << ' ' << graph_fingerprint(graph)
+       << '\n';
+    ss << "model " << (int) graph.diff_model << ' ' << graph.deadline << '\n';
+    ss << "A_batch";
+    for (node a : A_batch) ss << ' ' << a;
+    ss << "\nk_batch";
+    for (int32 k : k_batch) ss << ' ' << k;
+    ss << "\nsolvers";
+    for (IM_solver s : solver_batch) ss << ' ' << solver_name[s] << '=' << estimator_name[solver_estimator[s]];
+    ss << "\nrounds " << rounds << '\n';
+    ss << "MC_rounds " << MC_iteration_rounds << ' ' << MC_rel_error << '\n';
+    ss << "snapshots " << snapshot_rounds << " sketches " << sketch_instances << ' ' << sketch_size << '\n';
+    ss << "evaluator " << evaluator << ' ' << eval_RR_sets << '\n';
+    ss << "budget " << time_budget << " ppr_rmax " << ppr_rmax << " local";
+    if (!MG0_path.empty()) ss << ' ' << file_name(MG0_path) << ' ' << MG0_fingerprint(graph);
+    ss << '\n';
+    return ss.str();
+}
+
+#endif //EXP_CHECKPOINT_H
@@ -0,0 +1,171 @@
+// Solver contexts : the state of the solvers that belongs to one stream of queries
+
+#ifndef EXP_CONTEXT_H
+#define EXP_CONTEXT_H
+
+#include "RRpool.h"
+#include "participant.h"
+#include <mutex>
+#include <memory>
+
+/*!
+ * @brief The state of the solvers for one stream of queries.
+ *
+ * Everything that a solver writes during or between queries lives here : the random stream of the serial parts,
+ * the RI sets that IMM and OPIM keep between queries with their temporary arrays, the participant index, the
+ * estimator, the certified ratio and the profile of the current query, the output sinks and the pool of the
+ * parallel loops.
+ * The graph and the structures built from the graph alone (pagerank, bounds, sketches, snapshots, the evaluation
+ * pool) are shared by all contexts and are not copied.
+ *
+ * Every thread has a current context, the default one unless it is set by context_scope, and the workers of a
+ * parallel loop run in the context of the thread that started it. A context must only be used by one thread at
+ * a time, and different contexts can solve queries on the same graph concurrently.
+ */
+class Context {
+public:
+    ///the random stream of the serial parts of the solvers
+    std::minstd_rand engine;
+    ///log : sink of the seed sets printed by the solvers, out : sink of the result file
+    std::ostream *log, *out;
+    ///the spread estimator of the current solver
+    estimator_type spread_estimator = MC_ESTIMATOR;
+    ///R of IMM, R1 of OPIM for node selection and R2 for validation, all kept between queries
+    RRcollection R, R1_opim, R2_opim;
+    ///temporary arrays of the serial RI sampling and of the node selection of IMM and OPIM
+    RI_workspace ws;
+    vector<bool> nodeRemain;
+    vector<int64> coveredNum_tmp;
+    ///temporary arrays of the samplers of RRpool
+    vector<RI_workspace> sampler_workspaces;
+    ///the participant index of the last A
+    ParticipantIndex index;
+    ///the certified approximation ratio of the last call of OPIM_method or of the anytime IMM mode
+    double OPIM_ratio = 1;
+    ///number of RI sets in R1 and R2 that the last call of the anytime IMM mode has used
+    int64 anytime_RR_used = 0;
+    ///the phase timers and counters since the last solver call, see profile.h
+    Profile profile;
+
+    /*!
+     * @param threads : number of threads of the parallel loops of this context, 0 for num_threads
+     * @param log : sink of the seed sets printed by the solvers
+     * @param out : sink of the result file
+     */
+    explicit Context(int32 threads = 1, std::ostream &log = std::cout, std::ostream &out = std::cout)
+            : engine(rd__()), log(&log), out(&out), threads(threads) {
+        std::lock_guard<std::mutex> lock(registry_mtx());
+        registry().emplace_back(this);
+    }
+
+    ~Context() {
+        std::lock_guard<std::mutex> lock(registry_mtx());
+        auto &all = registry();
+        all.erase(find(all.begin(), all.end(), this));
+    }
+
+    Context(const Context &) = delete;
+
+    Context &operator=(const Context &) = delete;
+
+    /// the pool of the parallel loops, started at the first use
+    ThreadPool &pool() {
+        if (!own_pool) own_pool.reset(new ThreadPool(threads > 0 ? threads : num_threads));
+        return *own_pool;
+    }
+
+    /*!
+     * @brief Make the temporary arrays fit the graph. The RI set collections are emptied if n has changed.
+     */
+    void fit(Graph &graph) {
+        ws.resize(graph.n);
+        if (nodeRemain.size() < graph.n) nodeRemain.assign(graph.n, false);
+        if (coveredNum_tmp.size() < graph.n) coveredNum_tmp.assign(graph.n, 0);
+        for (RRcollection *C : {&R, &R1_opim, &R2_opim})
+            if (C->covered.size() != graph.n) C->init(graph.n);
+    }
+
+    /*!
+     * @brief Call f(context) for every context that exists.
+     * No context may be solving a query meanwhile.
+     */
+    template<class F>
+    static void for_each(F f) {
+        std::lock_guard<std::mutex> lock(registry_mtx());
+        for (Context *c : registry()) f(*c);
+    }
+
+private:
+    int32 threads;
+    std::unique_ptr<ThreadPool> own_pool;
+
+    static vector<Context *> &registry() {
+        static vector<Context *> all;
+        return all;
+    }
+
+    static std::mutex &registry_mtx() {
+        static std::mutex mtx;
+        return mtx;
+    }
+};
+
+/*!
+ * @brief The context of the threads that have not set one, with num_threads threads and the result file as out.
+ */
+Context &default_context() {
+    static Context context(0, std::cout, out);
+    return context;
+}
+
+/*!
+ * @brief The current context of the calling thread.
+ */
+Context &ctx() {
+    Context *context = current_context();
+    return context != nullptr ? *context : default_context();
+}
+
+/*!
+ * @brief Set the current context of the calling thread for the lifetime of this object.
+ */
+class context_scope {
+public:
+    explicit context_scope(Context &context) : previous(current_context()) {
+        current_context() = &context;
+    }
+
+    ~context_scope() {
+        current_context() = previous;
+    }
+
+private:
+    Context *previous;
+};
+
+ThreadPool &thread_pool() {
+    return ctx().pool();
+}
+
+std::ostream &log_sink() {
+    return *ctx().log;
+}
+
+std::ostream &output_sink() {
+    return *ctx().out;
+}
+
+Profile &profile() {
+    return ctx().profile;
+}
+
+/*!
+ * @brief The index of A on the graph in the current context, built only if A or the graph has changed.
+ */
+ParticipantIndex &participant_index(Graph &graph, const vector<node> &A) {
+    ParticipantIndex &index = ctx().index;
+    if (!index.built_for(graph, A)) index.build(graph, A);
+    return index;
+}
+
+#endif //EXP_CONTEXT_H
@@ -11,7 +11,8 @@
 #include <cstring>
 #include <sstream>
 #include <vector>
-#include "models.h"
+#include <algorithm>
+#include "profile.h"
 
 using namespace std;
 
@@ -41,6 +42,8 @@ public:
      */
     node n;
     int64 m, deadline;
+    ///incremented by every change of the edges, so that the caches built on the graph can tell it has changed
+    int64 version = 0;
     vector<vector<Edge> > g, gT;
     vector<node> deg_in, deg_out;
     model_type diff_model;
@@ -61,18 +64,11 @@ public:
     ~Graph() = default;
 
     /*!
-     * @brief Copy constructor.
+     * @brief The graph is large and shared read-only by all solver contexts, so it is never copied.
      */
-    Graph(Graph &g) {
-        n = g.n;
-        m = g.m;
-        deadline = g.deadline;
-        diff_model = g.diff_model;
-        this->g = g.g;
-        this->gT = g.gT;
-        this->deg_in = g.deg_in;
-        this->deg_out = g.deg_out;
-    }
+    Graph(const Graph &) = delete;
+
+    Graph &operator=(const Graph &) = delete;
 
     /*!
      * @brief add an weighted edge into graph.
@@ -88,13 +84,99 @@ public:
             deg_in.emplace_back(0);
             deg_out.emplace_back(0);
         }
-        m++;
+        m++, version++;
         deg_in[target]++;
         deg_out[source]++;
         g[source].emplace_back(Edge(target, weight, weight));
         gT[target].emplace_back(Edge(source, weight, weight));
     }
 
+    /*!
+     * @brief remove one copy of an edge from the graph. The order of the other edges of source and target may change.
+     * @param source : source node
+     * @param target : destination node
+     * @return : false if there is no such edge
+     */
+    bool remove_edge(node source, node target) {
+        if (source < 0 || source >= n || target < 0 || target >= n) return false;
+        auto erase = [](vector<Edge> &list, node v) {
+            for (auto &edge : list) {
+                if (edge.v != v) continue;
+                swap(edge, list.back());
+                list.pop_back();
+                return true;
+            }
+            return false;
+        };
+        if (!erase(g[source], target)) return false;
+        erase(gT[target], source);
+        m--, version++;
+        deg_in[target]--;
+        deg_out[source]--;
+        return true;
+    }
+
+    /*!
+     * @brief Delete and then insert a batch of edges, and update the probabilities of the current diffusion model
+     * only where they depend on a changed degree : p(u,v) on the in-edges of the nodes whose in-degree has changed,
+     * and m(u,v) on the out-edges of the nodes whose out-degree has changed. The probabilities are the same as
+     * set_diffusion_model would set on the new graph.
+     * @param insertions : the edges to insert
+     * @param deletions : the edges to delete, one copy for each, the edges that do not exist are ignored
+     * @param dirty : returns the nodes whose in-edges or their probabilities have changed, sorted.
+     * They are all the nodes on which a reverse traversal may behave differently.
+     * @return : number of edges deleted
+     */
+    int64 update_edges(const vector<pair<node, node>> &insertions, const vector<pair<node, node>> &deletions,
+                       vector<node> &dirty) {
+        vector<node> heads, tails;
+        int64 deleted = 0;
+        for (auto &e : deletions) {
+            if (!remove_edge(e.first, e.second)) continue;
+            deleted++;
+            tails.emplace_back(e.first), heads.emplace_back(e.second);
+        }
+        for (auto &e : insertions) {
+            add_edge(e.first, e.second);
+            tails.emplace_back(e.first), heads.emplace_back(e.second);
+        }
+        sort(heads.begin(), heads.end());
+        heads.erase(unique(heads.begin(), heads.end()), heads.end());
+        sort(tails.begin(), tails.end());
+        tails.erase(unique(tails.begin(), tails.end()), tails.end());
+        dirty = heads;
+        if (diff_model != IC && diff_model != IC_M) return deleted;
+        vector<bool> is_head(n, false), is_tail(n, false);
+        for (node v : heads) is_head[v] = true;
+        for (node u : tails) is_tail[u] = true;
+        //p(w,v) = 1 / deg_in[v] is stored in g[w] for every in-neighbour w of a head v
+        vector<node> sources;
+        for (node v : heads)
+            for (auto &edge : gT[v]) sources.emplace_back(edge.v);
+        sort(sources.begin(), sources.end());
+        sources.erase(unique(sources.begin(), sources.end()), sources.end());
+        for (node w : sources)
+            for (auto &edge : g[w])
+                if (is_head[edge.v]) edge.p = 1.0 / deg_in[edge.v];
+        if (diff_model == IC_M) {
+            for (node v : heads)
+                for (auto &edge : gT[v]) edge.p = 1.0 / deg_in[v];
+            //m(u,x) = 5 / (5 + deg_out[u]) is stored in g[u] and in gT[x] for every out-neighbour x of a tail u
+            for (node u : tails) {
+                for (auto &edge : g[u]) {
+                    edge.m = 5.0 / (5.0 + deg_out[u]);
+                    dirty.emplace_back(edge.v);
+                }
+            }
+            sort(dirty.begin(), dirty.end());
+            dirty.erase(unique(dirty.begin(), dirty.end()), dirty.end());
+            for (node x : dirty)
+                for (auto &edge : gT[x])
+                    if (is_tail[edge.v]) edge.m = 5.0 / (5.0 + deg_out[edge.v]);
+        }
+        return deleted;
+    }
+
 /*!
  * @brief load a graph through file
  * @param filename : the path of the file
@@ -128,14 +210,16 @@ public:
     }
 
     Graph(const string &filename, graph_type type) : Graph() {
+        phase_timer timer(PHASE_GRAPH_LOAD);
         this->open(filename, type);
     }
 
     /*!
-     * @brief Set the diffusion model to IC/LT. If you modify the graph later, you need to set it again.
+     * @brief Set the diffusion model to IC/LT. If you modify the graph later by add_edge, you need to set it again.
      * @param new_type : the name of the diffusion model.
      */
     void set_diffusion_model(model_type new_type, int64 new_deadline = 0) {
+        phase_timer timer(PHASE_DIFFUSION_MODEL);
         diff_model = new_type;
         if (new_type == IC) {
             for (int64 i = 0; i < n; i++) {
@@ -169,4 +253,29 @@ public:
     }
 };
 
+/*!
+ * @brief A hash of the graph structure and, optionally, the edge probabilities.
+ * @param graph : the graph
+ * @param with_weights : include the probabilities p and m of the edges or not
+ */
+uint64_t graph_fingerprint(Graph &graph, bool with_weights = true) {
+    uint64_t h = 0xCBF29CE484222325ull ^ (uint64_t) graph.n;
+    auto mix = [&](uint64_t x) {
+        h ^= x + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+        h *= 0x100000001B3ull;
+    };
+    mix((uint64_t) graph.m);
+    for (node u = 0; u < graph.n; u++) {
+        for (auto &edge : graph.g[u]) {
+            mix((uint64_t) u), mix((uint64_t) edge.v);
+            if (!with_weights) continue;
+            uint64_t p, m;
+            memcpy(&p, &edge.p, sizeof(p));
+            memcpy(&m, &edge.m, sizeof(m));
+            mix(p), mix(m);
+        }
+    }
+    return h;
+}
+
 #endif //UNTITLED_GRAPH_H
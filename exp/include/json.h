@@ -0,0 +1,149 @@
+// Minimal JSON lines : flat objects of numbers, strings and number arrays
+
+#ifndef EXP_JSON_H
+#define EXP_JSON_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <cstdio>
+#include <cctype>
+#include <cmath>
+
+using namespace std;
+
+/*!
+ * @brief A value of a flat JSON object : a number, a string, an array of numbers, or null.
+ */
+struct json_value {
+    enum kind_type { NUL, NUM, STR, ARR } kind = NUL;
+    double num = 0;
+    string str;
+    vector<double> arr;
+};
+
+typedef map<string, json_value> json_object;
+
+/*!
+ * @brief Parse one line that holds a flat JSON object. true, false and nested objects are not supported.
+ * @param line : the line
+ * @param obj : returns the members
+ * @param err : returns the reason if the line cannot be parsed
+ * @return : true if the line is parsed
+ */
+bool parse_json_object(const string &line, json_object &obj, string &err) {
+    size_t i = 0;
+    obj.clear();
+    auto skip = [&]() { while (i < line.size() && isspace((unsigned char) line[i])) i++; };
+    auto fail = [&](const string &reason) {
+        err = reason + " at column " + to_string(i + 1);
+        return false;
+    };
+    auto parse_string = [&](string &s) {
+        if (i >= line.size() || line[i] != '"') return false;
+        s.clear();
+        for (i++; i < line.size() && line[i] != '"'; i++) {
+            if (line[i] == '\\' && i + 1 < line.size()) i++;
+            s += line[i];
+        }
+        if (i >= line.size()) return false;
+        i++;
+        return true;
+    };
+    auto parse_number = [&](double &x) {
+        const char *begin = line.c_str() + i;
+        char *end;
+        x = strtod(begin, &end);
+        //strtod also reads nan, inf and numbers that overflow, which JSON does not have
+        if (end == begin || !std::isfinite(x)) return false;
+        i += end - begin;
+        return true;
+    };
+    skip();
+    if (i >= line.size() || line[i] != '{') return fail("expected '{'");
+    i++, skip();
+    if (i < line.size() && line[i] == '}') return true;
+    while (true) {
+        string key;
+        json_value val;
+        skip();
+        if (!parse_string(key)) return fail("expected a key");
+        skip();
+        if (i >= line.size() || line[i] != ':') return fail("expected ':'");
+        i++, skip();
+        if (i >= line.size()) return fail("expected a value");
+        if (line[i] == '"') {
+            val.kind = json_value::STR;
+            if (!parse_string(val.str)) return fail("unterminated string");
+        } else if (line[i] == '[') {
+            val.kind = json_value::ARR;
+            i++, skip();
+            if (i < line.size() && line[i] == ']') i++;
+            else {
+                while (true) {
+                    double x;
+                    skip();
+                    if (!parse_number(x)) return fail("expected a number");
+                    val.arr.emplace_back(x);
+                    skip();
+                    if (i < line.size() && line[i] == ',') {
+                        i++;
+                        continue;
+                    }
+                    if (i < line.size() && line[i] == ']') {
+                        i++;
+                        break;
+                    }
+                    return fail("expected ',' or ']'");
+                }
+            }
+        } else if (line.compare(i, 4, "null") == 0) {
+            i += 4;
+        } else {
+            val.kind = json_value::NUM;
+            if (!parse_number(val.num)) return fail("unsupported value");
+        }
+        obj[key] = val;
+        skip();
+        if (i < line.size() && line[i] == ',') {
+            i++;
+            continue;
+        }
+        if (i < line.size() && line[i] == '}') return true;
+        return fail("expected ',' or '}'");
+    }
+}
+
+/// the JSON string literal of s
+string json_string(const string &s) {
+    string res = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') res += '\\', res += c;
+        else if (c == '\n') res += "\\n";
+        else if ((unsigned char) c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            res += buf;
+        } else res += c;
+    }
+    return res + "\"";
+}
+
+/// the JSON number of x, null if it is not finite
+string json_number(double x) {
+    if (!std::isfinite(x)) return "null";
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.10g", x);
+    return buf;
+}
+
+/// the JSON array of the integers in v
+template<class T>
+string json_array(const vector<T> &v) {
+    string res = "[";
+    for (size_t i = 0; i < v.size(); i++) res += (i ? "," : "") + to_string(v[i]);
+    return res + "]";
+}
+
+#endif //EXP_JSON_H
@@ -0,0 +1,238 @@
+// Precomputed single-node spreads (MG0) : computation, binary file and loading
+
+#ifndef EXP_MG0_H
+#define EXP_MG0_H
+
+#include "simulation.h"
+#include "bounds.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*!
+ * @brief MG0[u] stores influence spread of {u}. It points into the loaded local file.
+ */
+double *MG0 = nullptr;
+
+///path of the local MG0 file given by -l, loaded at the first use
+string MG0_path;
+
+/*!
+ * @brief Header of the binary MG0 file.
+ *
+ * The file is the header, then one done flag per chunk of chunk_size nodes (padded to 8 bytes),
+ * then n doubles. A chunk is valid only after its flag is set, so an interrupted run can resume.
+ */
+struct MG0_header {
+    char magic[8];
+    uint32_t version;
+    int32_t model;
+    int64_t n, m, deadline, rounds, chunk_size;
+    char estimator[8];
+    uint64_t graph_hash;
+};
+
+const char MG0_magic[8] = {'B', 'I', 'M', 'M', 'G', '0', '\n', '\0'};
+const uint32_t MG0_version = 1;
+
+/*!
+ * @brief The header of the MG0 file of the graph with its current diffusion model.
+ */
+MG0_header make_MG0_header(Graph &graph, const string &estimator, int64 rounds, int64 chunk_size) {
+    MG0_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MG0_magic, sizeof(h.magic));
+    h.version = MG0_version;
+    h.model = graph.diff_model;
+    h.n = graph.n, h.m = graph.m, h.deadline = graph.deadline;
+    h.rounds = rounds, h.chunk_size = chunk_size;
+    strncpy(h.estimator, estimator.c_str(), sizeof(h.estimator) - 1);
+    h.graph_hash = graph_fingerprint(graph);
+    return h;
+}
+
+int64 MG0_flags_size(const MG0_header &h) {
+    int64 chunks = (h.n + h.chunk_size - 1) / h.chunk_size;
+    return (chunks + 7) / 8 * 8;
+}
+
+int64 MG0_file_size(const MG0_header &h) {
+    return sizeof(MG0_header) + MG0_flags_size(h) + h.n * (int64) sizeof(double);
+}
+
+/*!
+ * @brief Compute sigma({u}) for all nodes and write them to a binary MG0 file.
+ *
+ * mc and bp run MC_iteration_rounds cascades per node. Nodes are processed in chunks, the nodes of a chunk
+ * in parallel on the thread pool, and every finished chunk is synced to the file, so an interrupted run
+ * resumes from the finished chunks if the file was made with the same graph, model and settings.
+ * rr estimates all nodes at once from their coverage in MC_iteration_rounds * n / 64 RI sets.
+ * @param graph : the graph with its diffusion model
+ * @param path : the output file
+ * @param estimator : mc, bp or rr
+ */
+void precompute_MG0(Graph &graph, const string &path, const string &estimator) {
+    double cur = wall_clock();
+    int64 rounds = estimator == "rr" ? max((int64) 1, MC_iteration_rounds * graph.n / 64) : MC_iteration_rounds;
+    MG0_header h = make_MG0_header(graph, estimator, rounds, 4096);
+    int64 chunks = (h.n + h.chunk_size - 1) / h.chunk_size;
+    int64 flags_off = sizeof(MG0_header), values_off = flags_off + MG0_flags_size(h);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "(get error) cannot open MG0 file: " << path << std::endl;
+        std::exit(-1);
+    }
+    //resume only if the file is complete in size and made with the same settings
+    MG0_header old;
+    struct stat sb;
+    fstat(fd, &sb);
+    bool resume = sb.st_size == MG0_file_size(h) && pread(fd, &old, sizeof(old), 0) == sizeof(old) &&
+                  memcmp(&old, &h, sizeof(h)) == 0;
+    vector<uint8_t> done(chunks, 0);
+    if (resume) {
+        if (pread(fd, done.data(), chunks, flags_off) != chunks) resume = false;
+    }
+    if (!resume) {
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, MG0_file_size(h)) != 0 ||
+            pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) {
+            std::cerr << "(get error) cannot write MG0 file: " << path << std::endl;
+            std::exit(-1);
+        }
+        done.assign(chunks, 0);
+    }
+    int64 finished = 0;
+    for (uint8_t d : done) finished += d;
+    cout << "precompute MG0 : n = " << h.n << ", estimator = " << estimator << ", rounds = " << rounds
+         << ", chunks done = " << finished << " / " << chunks << endl;
+    auto write_chunk = [&](int64 c, const double *values, int64 num) {
+        uint8_t flag = 1;
+        if (pwrite(fd, values, num * sizeof(double), values_off + c * h.chunk_size * (int64) sizeof(double)) !=
+            num * (int64) sizeof(double) || fdatasync(fd) != 0 || pwrite(fd, &flag, 1, flags_off + c) != 1 ||
+            fdatasync(fd) != 0) {
+            std::cerr << "(get error) cannot write MG0 file: " << path << std::endl;
+            std::exit(-1);
+        }
+    };
+    if (estimator == "rr") {
+        if (finished < chunks) {
+            vector<int64> cov = singleton_coverage(graph, rounds);
+            vector<double> values(graph.n);
+            for (node u = 0; u < graph.n; u++) values[u] = (double) cov[u] * graph.n / rounds;
+            for (int64 c = 0; c < chunks; c++)
+                write_chunk(c, values.data() + c * h.chunk_size, min(h.chunk_size, h.n - c * h.chunk_size));
+        }
+    } else {
+        ThreadPool &pool = thread_pool();
+        vector<double> values(h.chunk_size);
+        for (int64 c = 0; c < chunks; c++) {
+            if (done[c]) continue;
+            node first = c * h.chunk_size, num = min(h.chunk_size, h.n - first);
+            pool.parallel_for(num, [&](int32 tid, int64 i) {
+                vector<node> S(1, first + i);
+                int64 sum = 0;
+                if (estimator == "bp") {
+                    for (int64 r = 0; r < rounds; r += 64) {
+                        int64 lanes = min((int64) 64, rounds - r);
+                        sum += BP_pass(graph, S, lanes == 64 ? ~0ull : (1ull << lanes) - 1, thread_BP_state());
+                    }
+                } else {
+                    MC_state &st = thread_MC_state();
+                    st.resize(graph.n);
+                    for (int64 r = 0; r < rounds; r++) sum += MC_round(graph, S, st);
+                }
+                values[i] = (double) sum / rounds;
+            });
+            write_chunk(c, values.data(), num);
+            finished++;
+            if (verbose_flag) printf("\tchunk %ld done. %ld / %ld, time = %.3f\n", (long) c, (long) finished,
+                                     (long) chunks, time_by(cur));
+        }
+    }
+    close(fd);
+    cout << "precompute MG0 done. file = " << path << ", time = " << time_by(cur) << endl;
+}
+
+/*!
+ * @brief Load the binary MG0 file by mmap after checking that it matches the graph and its diffusion model.
+ * @return : false if the file is not a binary MG0 file
+ */
+bool load_MG0_binary(Graph &graph, const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    MG0_header h;
+    if (pread(fd, &h, sizeof(h), 0) != sizeof(h) || memcmp(h.magic, MG0_magic, sizeof(h.magic)) != 0) {
+        close(fd);
+        return false;
+    }
+    auto fail = [&](const string &reason) {
+        std::cerr << "(get error) MG0 file " << path << " does not match : " << reason << std::endl;
+        std::exit(-1);
+    };
+    if (h.version != MG0_version) fail("version");
+    if (h.n != graph.n || h.m != graph.m) fail("graph size");
+    if (h.model != graph.diff_model || (graph.diff_model == IC_M && h.deadline != graph.deadline))
+        fail("diffusion model");
+    struct stat sb;
+    fstat(fd, &sb);
+    if (sb.st_size != MG0_file_size(h)) fail("file size");
+    if (h.graph_hash != graph_fingerprint(graph)) fail("graph hash");
+    void *base = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) fail("mmap");
+    auto *flags = (const uint8_t *) base + sizeof(MG0_header);
+    for (int64 c = 0; c < (h.n + h.chunk_size - 1) / h.chunk_size; c++)
+        if (!flags[c]) fail("unfinished chunk " + to_string(c));
+    MG0 = (double *) (flags + MG0_flags_size(h));
+    cout << "MG0 loaded from " << path << ", estimator = " << h.estimator << ", rounds = " << h.rounds << endl;
+    return true;
+}
+
+/*!
+ * @brief The single-node spreads of the local file given by -l, loaded at the first use.
+ *
+ * Binary files are validated against the graph and its diffusion model. Text files have no metadata,
+ * so only the number of values is checked. It is loaded once for all solver contexts.
+ */
+double *local_MG0(Graph &graph) {
+    static vector<double> text_values;
+    static const Graph *loaded_for = nullptr;
+    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock(mtx);
+    if (MG0 != nullptr && loaded_for == &graph) return MG0;
+    loaded_for = &graph;
+    if (load_MG0_binary(graph, MG0_path)) return MG0;
+    ifstream inFile(MG0_path, ios::in);
+    if (!inFile.is_open()) {
+        std::cerr << "(get error) local file not found: " << MG0_path << std::endl;
+        std::exit(-1);
+    }
+    text_values.clear();
+    double x;
+    while (inFile >> x) text_values.emplace_back(x);
+    inFile.close();
+    if (text_values.size() != graph.n) {
+        std::cerr << "(get error) local file " << MG0_path << " has " << text_values.size() << " values, but n = "
+                  << graph.n << std::endl;
+        std::exit(-1);
+    }
+    MG0 = text_values.data();
+    return MG0;
+}
+
+/*!
+ * @brief A hash of the single-node spreads of the local file given by -l, which are loaded if they are not yet.
+ */
+uint64_t MG0_fingerprint(Graph &graph) {
+    double *values = local_MG0(graph);
+    uint64_t h = 0xCBF29CE484222325ull ^ (uint64_t) graph.n;
+    for (node u = 0; u < graph.n; u++) {
+        uint64_t x;
+        memcpy(&x, &values[u], sizeof(x));
+        h ^= x + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+#endif //EXP_MG0_H
@@ -8,6 +8,7 @@
 #include <random>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 
 #define MAX_NODE_SIZE 5000000
 #define graph_type int8_t
@@ -30,34 +31,48 @@
 #define CELF_ADVANCED 6
 #define IMM_NORMAL 7
 #define IMM_ADVANCED 8
+#define OPIM_NORMAL 9
+#define LOCAL_PPR 10
+
+#define estimator_type int8_t
+#define MC_ESTIMATOR 0
+#define BP_ESTIMATOR 1
+#define SNAPSHOT_ESTIMATOR 2
+#define SKETCH_ESTIMATOR 3
 
 typedef int64_t node;
 typedef int32_t int32;
 typedef int64_t int64;
 
 std::random_device rd__;
-std::minstd_rand random_engine(rd__());
-std::uniform_real_distribution<double> distrib(0.0, 1.0);
 
 std::ofstream out;
 int8_t verbose_flag, local_mg;
 int64_t MC_iteration_rounds = 10000;
+double MC_rel_error = 0;
+int32_t num_threads = 1;
+int8_t pipeline_flag;
+
+/// the sinks of the seed sets and of the result file of the current solver context, see context.h
+std::ostream &log_sink();
+
+std::ostream &output_sink();
 
 /*!
- * @brief Random number generator that generates real number between [0,1)
- * @return A random real number between [0,1)
+ * @brief wall-clock timestamp in seconds, which is also correct when several threads are running.
+ * @return the timestamp
  */
-inline double random_real() {
-    return distrib(random_engine);
+inline double wall_clock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 /*!
  * @brief calculate the interval from start time.
- * @param start : start timestamp
+ * @param start : start timestamp got by wall_clock()
  * @return the length of the interval
  */
 double time_by(double start) {
-    return (clock() - start) / CLOCKS_PER_SEC;
+    return wall_clock() - start;
 }
 
 /*!
@@ -67,13 +82,14 @@ double time_by(double start) {
 void print_set(std::vector<node> &S, const std::string &Prefix = "") {
     std::vector<node> S_ordered = S;
     std::sort(S_ordered.begin(), S_ordered.end());
-    std::cout << Prefix;
-    std::cout << "{";
+    std::ostream &log = log_sink();
+    log << Prefix;
+    log << "{";
     for (int64 i = 0; i < S_ordered.size(); i++) {
-        std::cout << S_ordered[i];
-        if (i != S_ordered.size() - 1) std::cout << ",";
+        log << S_ordered[i];
+        if (i != S_ordered.size() - 1) log << ",";
     }
-    std::cout << "}[" << S_ordered.size() << "]";
+    log << "}[" << S_ordered.size() << "]";
 }
 
 /*!
@@ -84,6 +100,7 @@ void print_set_f(std::vector<node> &S, const std::string &Prefix = "") {
     if(S.size() > 100) return;
     std::vector<node> S_ordered = S;
     std::sort(S_ordered.begin(), S_ordered.end());
+    std::ostream &out = output_sink();
     out << Prefix;
     out << "{";
     for (int64 i = 0; i < S_ordered.size(); i++) {
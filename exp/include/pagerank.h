@@ -0,0 +1,211 @@
+// PageRank scores shared by the pagerank solvers : parallel kernel, memory and disk cache
+
+#ifndef EXP_PAGERANK_H
+#define EXP_PAGERANK_H
+
+#include "graph.h"
+#include "threadpool.h"
+#include <tuple>
+#include <queue>
+#include <memory>
+#include <unistd.h>
+
+/*!
+ * @brief Prefix of the disk cache of PageRank scores, the file is <prefix>.pagerank_<alpha>.
+ * The disk cache is not used if it is empty.
+ */
+string pagerank_cache_prefix;
+
+/*!
+ * @brief Header of the PageRank cache file, followed by n doubles.
+ */
+struct pagerank_header {
+    char magic[8];
+    int64_t n, m;
+    double alpha, l1_error;
+    uint64_t graph_hash;
+};
+
+const char pagerank_magic[8] = {'B', 'I', 'M', 'P', 'R', '1', '\n', '\0'};
+
+/*!
+ * @brief Use power iteration method to calculate pagerank values of nodes in graph.
+ *
+ * Every iteration pulls x'[v] = alpha / n + (1 - alpha) * (sum_{u -> v} x[u] / deg_out[u] + D / n) along the
+ * in-edges, where D is the total value of the dangling nodes (including isolated nodes), which is spread
+ * uniformly so that no value is lost. The nodes are split into blocks that run on the thread pool.
+ * @param graph : the graph
+ * @param pi : returns a size-n vector, containing pagerank values of all nodes
+ * @param alpha : initialized usually as 0.15 or 0.2
+ * @param l1_error : The precision that needs to be achieved, as the l1 change of one iteration
+ * @return : number of iterations
+ */
+int64 power_iteration(Graph &graph, vector<double> &pi, double alpha, double l1_error = 1e-9) {
+    ThreadPool &pool = thread_pool();
+    node n = graph.n;
+    pi.assign(n, 1.0 / n);
+    vector<double> share(n), next(n);
+    int64 blocks = min((int64) n, (int64) pool.size() * 8);
+    vector<double> dangling(blocks), diff(blocks);
+    auto block_of = [&](int64 b) { return make_pair(n * b / blocks, n * (b + 1) / blocks); };
+    int64 iter = 0;
+    for (double delta = 1; delta > l1_error; iter++) {
+        pool.parallel_for(blocks, [&](int32 tid, int64 b) {
+            double d = 0;
+            for (node u = block_of(b).first; u < block_of(b).second; u++) {
+                if (graph.deg_out[u] == 0) d += pi[u], share[u] = 0;
+                else share[u] = pi[u] / graph.deg_out[u];
+            }
+            dangling[b] = d;
+        });
+        double D = 0;
+        for (double d : dangling) D += d;
+        double base = alpha / n + (1 - alpha) * D / n;
+        pool.parallel_for(blocks, [&](int32 tid, int64 b) {
+            double d = 0;
+            for (node v = block_of(b).first; v < block_of(b).second; v++) {
+                double sum = 0;
+                for (auto &edge : graph.gT[v]) sum += share[edge.v];
+                next[v] = base + (1 - alpha) * sum;
+                d += fabs(next[v] - pi[v]);
+            }
+            diff[b] = d;
+        });
+        pi.swap(next);
+        delta = 0;
+        for (double d : diff) delta += d;
+    }
+    return iter;
+}
+
+/*!
+ * @brief Load the PageRank cache file if it is made for the same graph structure, alpha and precision.
+ */
+bool load_pagerank(const string &path, const pagerank_header &h, vector<double> &pi) {
+    ifstream inFile(path, ios::in | ios::binary);
+    if (!inFile.is_open()) return false;
+    pagerank_header old;
+    if (!inFile.read((char *) &old, sizeof(old)) || memcmp(&old, &h, sizeof(h)) != 0) return false;
+    pi.resize(h.n);
+    return (bool) inFile.read((char *) pi.data(), h.n * (int64) sizeof(double));
+}
+
+/*!
+ * @brief Write the PageRank cache file through a temporary file, so that it is never left incomplete.
+ */
+void save_pagerank(const string &path, const pagerank_header &h, const vector<double> &pi) {
+    string tmp = path + ".tmp" + to_string(getpid());
+    ofstream outFile(tmp, ios::out | ios::binary | ios::trunc);
+    bool ok = outFile.is_open() && outFile.write((const char *) &h, sizeof(h)) &&
+              outFile.write((const char *) pi.data(), h.n * (int64) sizeof(double));
+    outFile.close();
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        if (verbose_flag) cout << "\tcannot write pagerank cache " << path << endl;
+    }
+}
+
+/*!
+ * @brief PageRank scores of the graph, computed once and shared by all pagerank solvers and solver contexts.
+ *
+ * The scores are kept in memory as long as the graph does not change, and in the disk cache given by
+ * pagerank_cache_prefix, which is checked against a hash of the graph structure. They are returned as a snapshot,
+ * so a caller can keep reading them while a change of the graph makes another caller compute new ones.
+ * @param graph : the graph
+ * @param alpha : the teleport probability
+ * @return : the pagerank values, indexed by node
+ */
+std::shared_ptr<const vector<double>> pagerank(Graph &graph, double alpha = 0.2) {
+    const double l1_error = 1e-9;
+    static std::shared_ptr<const vector<double>> snapshot;
+    static tuple<const Graph *, node, int64, int64, double> key;
+    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock(mtx);
+    auto now = make_tuple((const Graph *) &graph, graph.n, graph.m, graph.version, alpha);
+    if (now == key && snapshot && snapshot->size() == graph.n) return snapshot;
+    key = now;
+    auto pi = std::make_shared<vector<double>>();
+    double cur = wall_clock();
+    pagerank_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, pagerank_magic, sizeof(h.magic));
+    h.n = graph.n, h.m = graph.m, h.alpha = alpha, h.l1_error = l1_error;
+    string path;
+    if (!pagerank_cache_prefix.empty()) {
+        h.graph_hash = graph_fingerprint(graph, false);
+        path = pagerank_cache_prefix + ".pagerank_" + to_string(alpha);
+        if (load_pagerank(path, h, *pi)) {
+            if (verbose_flag) printf("\tpagerank loaded from %s, time = %.3f\n", path.c_str(), time_by(cur));
+            return snapshot = pi;
+        }
+    }
+    int64 iter = power_iteration(graph, *pi, alpha, l1_error);
+    if (verbose_flag) printf("\tpagerank done. iterations = %ld, time = %.3f\n", (long) iter, time_by(cur));
+    if (!path.empty()) save_pagerank(path, h, *pi);
+    return snapshot = pi;
+}
+
+///residual threshold of the forward push of local_ppr, relative to the out-degree
+double ppr_rmax = 1e-6;
+
+/*!
+ * @brief Personalized PageRank from a set of sources by forward push, without touching the rest of the graph.
+ *
+ * The sources share the start value equally. A node u with residual r(u) > rmax * deg_out(u) keeps alpha * r(u)
+ * as its estimate and pushes the rest equally to its out-neighbours, while a dangling node keeps all of r(u).
+ * The number of pushes is O(1 / (alpha * rmax)), so the cost depends only on the explored neighbourhood.
+ * At the end, every node also keeps alpha times the residual it was left with.
+ * The dense workspaces are allocated once per thread and only the touched nodes are reset between calls.
+ * @param graph : the graph
+ * @param sources : the start nodes
+ * @param alpha : the teleport probability
+ * @param rmax : the residual threshold
+ * @param explored : returns the number of nodes with a nonzero estimate or residual
+ * @return : the estimates, indexed by node
+ */
+const vector<double> &local_ppr(Graph &graph, const vector<node> &sources, double alpha, double rmax,
+                                int64 &explored) {
+    static thread_local vector<double> p, r;
+    static thread_local vector<bool> seen, queued;
+    static thread_local vector<node> touched;
+    if (p.size() != graph.n) {
+        p.assign(graph.n, 0), r.assign(graph.n, 0);
+        seen.assign(graph.n, false), queued.assign(graph.n, false);
+        touched.clear();
+    }
+    for (node u : touched) p[u] = r[u] = 0, seen[u] = false;
+    touched.clear();
+    auto touch = [&](node u) {
+        if (!seen[u]) seen[u] = true, touched.emplace_back(u);
+    };
+    auto active = [&](node u) { return r[u] > rmax * max((node) 1, graph.deg_out[u]); };
+    std::queue<node> Q;
+    for (node u : sources) touch(u), r[u] += 1.0 / sources.size();
+    for (node u : sources)
+        if (!queued[u] && active(u)) queued[u] = true, Q.push(u);
+    while (!Q.empty()) {
+        node u = Q.front();
+        Q.pop();
+        queued[u] = false;
+        double ru = r[u];
+        r[u] = 0;
+        if (graph.deg_out[u] == 0) {
+            p[u] += ru;
+            continue;
+        }
+        p[u] += alpha * ru;
+        double inc = (1 - alpha) * ru / graph.deg_out[u];
+        for (auto &edge : graph.g[u]) {
+            node v = edge.v;
+            touch(v);
+            r[v] += inc;
+            if (!queued[v] && active(v)) queued[v] = true, Q.push(v);
+        }
+    }
+    //the residuals left below the threshold still add alpha * r(u) to u
+    for (node u : touched) p[u] += alpha * r[u];
+    explored = (int64) touched.size();
+    return p;
+}
+
+#endif //EXP_PAGERANK_H
@@ -0,0 +1,135 @@
+// Participant-neighbourhood index shared by the solvers
+
+#ifndef EXP_PARTICIPANT_H
+#define EXP_PARTICIPANT_H
+
+#include "graph.h"
+#include <algorithm>
+
+/*!
+ * @brief Read-only view of a contiguous node list.
+ */
+struct node_range {
+    const node *first, *last;
+
+    const node *begin() const { return first; }
+
+    const node *end() const { return last; }
+
+    int64 size() const { return last - first; }
+};
+
+/*!
+ * @brief The neighbourhood structure of an active participant set A.
+ *
+ * in_A : bitmap of A
+ * candidates : all out-neighbours of A that are not in A, sorted and distinct
+ * neighbours(j) : out-neighbours of A[j] that are not in A, distinct (CSR)
+ * sources(v) : positions in A of the participants that reach candidate v, in random order (CSR)
+ */
+class ParticipantIndex {
+public:
+    vector<node> A;
+    vector<bool> in_A;
+    vector<node> candidates;
+
+    ParticipantIndex() = default;
+
+    ParticipantIndex(Graph &graph, const vector<node> &A) {
+        build(graph, A);
+    }
+
+    void build(Graph &graph, const vector<node> &participants) {
+        owner = &graph, n = graph.n, m = graph.m, version = graph.version;
+        A = participants;
+        in_A.assign(graph.n, false);
+        for (node u : A) in_A[u] = true;
+        nbr_offset.assign(1, 0);
+        nbr.clear();
+        for (node u : A) {
+            auto first = (int64) nbr.size();
+            for (auto &edge : graph.g[u])
+                if (!in_A[edge.v]) nbr.emplace_back(edge.v);
+            sort(nbr.begin() + first, nbr.end());
+            nbr.erase(unique(nbr.begin() + first, nbr.end()), nbr.end());
+            nbr_offset.emplace_back(nbr.size());
+        }
+        candidates = nbr;
+        sort(candidates.begin(), candidates.end());
+        candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+        //counting sort of (candidate, participant) pairs into the source lists
+        pos.assign(graph.n, -1);
+        for (int64 i = 0; i < candidates.size(); i++) pos[candidates[i]] = i;
+        src_offset.assign(candidates.size() + 1, 0);
+        for (node v : nbr) src_offset[pos[v] + 1]++;
+        for (int64 i = 0; i < candidates.size(); i++) src_offset[i + 1] += src_offset[i];
+        src.assign(nbr.size(), 0);
+        vector<int64> fill(src_offset.begin(), src_offset.end() - 1);
+        for (int64 j = 0; j < A.size(); j++)
+            for (int64 i = nbr_offset[j]; i < nbr_offset[j + 1]; i++) src[fill[pos[nbr[i]]]++] = j;
+        std::mt19937 engine(rd__());
+        for (int64 i = 0; i < candidates.size(); i++)
+            shuffle(src.begin() + src_offset[i], src.begin() + src_offset[i + 1], engine);
+    }
+
+    /// check if the index is built for A on the graph
+    bool built_for(Graph &graph, const vector<node> &participants) const {
+        return owner == &graph && n == graph.n && m == graph.m && version == graph.version && A == participants;
+    }
+
+    node_range neighbours(int64 j) const {
+        return node_range{nbr.data() + nbr_offset[j], nbr.data() + nbr_offset[j + 1]};
+    }
+
+    node_range sources(node v) const {
+        if (pos[v] < 0) return node_range{nullptr, nullptr};
+        return node_range{src.data() + src_offset[pos[v]], src.data() + src_offset[pos[v] + 1]};
+    }
+
+private:
+    const Graph *owner = nullptr;
+    node n = 0;
+    int64 m = 0, version = 0;
+    vector<node> nbr, src;
+    vector<int64> nbr_offset, src_offset, pos;
+};
+
+/*!
+ * @brief The quota of the advanced solvers : every participant can bring at most k seeds.
+ *
+ * used[j] : how many seeds the participant A[j] has brought
+ */
+class ParticipantQuota {
+public:
+    ParticipantQuota(const ParticipantIndex &index, int32 k) : index(index), k(k), used(index.A.size(), 0) {}
+
+    /*!
+     * @brief Select the participant of candidate v that has brought the fewest seeds.
+     * @return : its position in A, and -1 if all participants of v have used up their quota.
+     */
+    int64 source(node v) const {
+        int64 best = -1;
+        for (node j : index.sources(v))
+            if (best == -1 || used[j] < used[best]) best = j;
+        if (best == -1 || used[best] >= k) return -1;
+        return best;
+    }
+
+    /// check if v can still be selected
+    bool available(node v) const {
+        return source(v) != -1;
+    }
+
+    /// count v as a seed brought by its source participant
+    void take(node v) {
+        int64 j = source(v);
+        if (j != -1) used[j]++;
+    }
+
+private:
+    const ParticipantIndex &index;
+    int32 k;
+    vector<int32> used;
+};
+
+#endif //EXP_PARTICIPANT_H
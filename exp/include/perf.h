@@ -0,0 +1,113 @@
+// Hardware performance counters of the calling thread by perf_event_open
+
+#ifndef EXP_PERF_H
+#define EXP_PERF_H
+
+#include "models.h"
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+enum perf_counter_id {
+    PERF_CYCLES, PERF_INSTRUCTIONS, PERF_LLC_MISSES, PERF_BRANCH_MISSES, PERF_NUM
+};
+const char *perf_name[PERF_NUM] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+
+///hardware counters are attached to the phases, set by --perf and cleared if the counters cannot be opened
+std::atomic<bool> perf_flag(false);
+///perf_missing[i] : the counter i cannot be opened on this machine
+std::atomic<bool> perf_missing[PERF_NUM];
+
+/*!
+ * @brief The values of the counters, -1 for a counter that is not available on this machine.
+ */
+struct perf_values {
+    int64 v[PERF_NUM];
+};
+
+/*!
+ * @brief A group of the hardware counters of the calling thread, in user space only.
+ *
+ * The cycles counter is the leader and the others are added if the machine has them, so all of them are read
+ * at once. If the leader cannot be opened (no PMU in a VM, or perf_event_paranoid), perf_flag is cleared with
+ * one warning and the phases are only timed.
+ */
+class PerfGroup {
+public:
+    PerfGroup() {
+        const uint64_t config[PERF_NUM] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                           PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int32 i = 0; i < PERF_NUM; i++) slot[i] = -1;
+        for (int32 i = 0; i < PERF_NUM; i++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = config[i];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            int fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : leader, 0);
+            if (i == 0 && fd < 0) {
+                bool expected = true;
+                if (perf_flag.compare_exchange_strong(expected, false))
+                    std::cerr << "(get warning) hardware counters are not available (" << strerror(errno)
+                              << "), phases are only timed" << std::endl;
+                return;
+            }
+            if (fd < 0) {
+                perf_missing[i] = true;
+                continue;
+            }
+            if (i == 0) leader = fd;
+            else members.emplace_back(fd);
+            slot[i] = num++;
+        }
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    ~PerfGroup() {
+        for (int fd : members) close(fd);
+        if (leader >= 0) close(leader);
+    }
+
+    PerfGroup(const PerfGroup &) = delete;
+
+    PerfGroup &operator=(const PerfGroup &) = delete;
+
+    /*!
+     * @brief Read all the counters.
+     * @return : false if the counters are not open
+     */
+    bool read_values(perf_values &res) {
+        if (leader < 0) return false;
+        uint64_t buf[PERF_NUM + 1];
+        if (read(leader, buf, sizeof(uint64_t) * (num + 1)) != (ssize_t) (sizeof(uint64_t) * (num + 1)))
+            return false;
+        for (int32 i = 0; i < PERF_NUM; i++) res.v[i] = slot[i] >= 0 ? (int64) buf[slot[i] + 1] : -1;
+        return true;
+    }
+
+private:
+    int leader = -1;
+    std::vector<int> members;
+    ///slot[i] : the position of the counter i in the group, -1 if it is not available
+    int32 slot[PERF_NUM];
+    int32 num = 0;
+};
+
+/*!
+ * @brief The counters of the calling thread, opened at its first use.
+ */
+PerfGroup &thread_perf() {
+    static thread_local PerfGroup group;
+    return group;
+}
+
+#endif //EXP_PERF_H
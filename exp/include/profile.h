@@ -0,0 +1,231 @@
+// Instrumentation : wall-clock phase timers and counters of the hot paths, one JSON record per solver call
+
+#ifndef EXP_PROFILE_H
+#define EXP_PROFILE_H
+
+#include "perf.h"
+#include <atomic>
+#include <mutex>
+#include <fstream>
+#include <string>
+
+enum profile_phase {
+    PHASE_GRAPH_LOAD, PHASE_DIFFUSION_MODEL, PHASE_RR_SAMPLING, PHASE_NODE_SELECTION, PHASE_MC_SIMULATION, PHASE_NUM
+};
+const char *phase_name[PHASE_NUM] = {"graph_load", "diffusion_model", "rr_sampling", "node_selection",
+                                     "mc_simulation"};
+
+enum profile_counter {
+    COUNTER_RR_SETS, COUNTER_MC_ROUNDS, COUNTER_EDGES, COUNTER_HEAP_PUSHES, COUNTER_CELF_REEVALUATIONS, COUNTER_NUM
+};
+const char *counter_name[COUNTER_NUM] = {"rr_sets", "mc_rounds", "edges_examined", "heap_pushes",
+                                         "celf_reevaluations"};
+
+///profiling is on, set by --profile. Every timer and counter is a single branch when it is off
+int8_t profile_flag;
+///the file of the records, one JSON object per line
+std::ofstream profile_out;
+std::mutex profile_mtx;
+
+/*!
+ * @brief The phase times in nanoseconds and the counters of one solver context since its last record.
+ *
+ * The phases are timed on the thread that starts them, outside of the parallel loops, so the time of a phase is
+ * wall-clock time. A phase that runs on several threads at once, e.g. the MC rounds of enumeration_method, adds up
+ * the time of every thread. The hardware counters and the edges of a phase add up all the threads that work for it :
+ * the thread that starts it, the workers of its parallel loops and the samplers of the pipelined IMM.
+ */
+struct Profile {
+    std::atomic<int64> nanos[PHASE_NUM], counts[COUNTER_NUM];
+    ///hardware counters and edges examined of each phase
+    std::atomic<int64> perf[PHASE_NUM][PERF_NUM], edges[PHASE_NUM];
+
+    Profile() {
+        reset();
+    }
+
+    void reset() {
+        for (auto &x : nanos) x.store(0, std::memory_order_relaxed);
+        for (auto &x : counts) x.store(0, std::memory_order_relaxed);
+        for (auto &p : perf) for (auto &x : p) x.store(0, std::memory_order_relaxed);
+        for (auto &x : edges) x.store(0, std::memory_order_relaxed);
+    }
+};
+
+/// the profile of the current solver context, see context.h
+Profile &profile();
+
+/*!
+ * @brief The profile of the phases that belong to the graph and not to a query (graph load, diffusion model),
+ * which are added to the next record of any context.
+ */
+Profile &graph_profile() {
+    static Profile p;
+    return p;
+}
+
+/*!
+ * @brief The profile that the time and the counters of a phase go to.
+ */
+Profile &phase_profile(int32 phase) {
+    return phase == PHASE_GRAPH_LOAD || phase == PHASE_DIFFUSION_MODEL ? graph_profile() : profile();
+}
+
+/*!
+ * @brief The sums of all records of the process, for print_perf_summary.
+ */
+Profile &profile_totals() {
+    static Profile p;
+    return p;
+}
+
+/*!
+ * @brief The innermost phase that the calling thread works for, -1 for none.
+ */
+int32 &current_phase() {
+    static thread_local int32 phase = -1;
+    return phase;
+}
+
+/*!
+ * @brief Add x to a counter of the current solver context. The edges are also added to the current phase.
+ */
+inline void profile_count(profile_counter counter, int64 x = 1) {
+    if (!profile_flag) return;
+    Profile &p = profile();
+    p.counts[counter].fetch_add(x, std::memory_order_relaxed);
+    if (counter == COUNTER_EDGES && current_phase() >= 0)
+        p.edges[current_phase()].fetch_add(x, std::memory_order_relaxed);
+}
+
+/*!
+ * @brief Add the hardware counters of the calling thread from its construction to its destruction to a phase of
+ * the current context. It does nothing for phase -1 or without --perf.
+ */
+class perf_scope {
+public:
+    explicit perf_scope(int32 phase) : phase(phase) {
+        active = phase >= 0 && perf_flag && thread_perf().read_values(start);
+    }
+
+    ~perf_scope() {
+        perf_values end;
+        if (!active || !thread_perf().read_values(end)) return;
+        for (int32 i = 0; i < PERF_NUM; i++)
+            if (end.v[i] >= 0) phase_profile(phase).perf[phase][i].fetch_add(end.v[i] - start.v[i]);
+    }
+
+    perf_scope(const perf_scope &) = delete;
+
+    perf_scope &operator=(const perf_scope &) = delete;
+
+private:
+    int32 phase;
+    bool active;
+    perf_values start;
+};
+
+/*!
+ * @brief Add the wall-clock time from its construction to its destruction to a phase of the current context,
+ * and with --perf the hardware counters of the calling thread. The phase is the current phase meanwhile.
+ */
+class phase_timer {
+public:
+    explicit phase_timer(profile_phase phase)
+            : phase(phase), previous(current_phase()), start(profile_flag ? wall_clock() : 0),
+              counters(profile_flag ? phase : -1) {
+        if (profile_flag) current_phase() = phase;
+    }
+
+    ~phase_timer() {
+        if (!profile_flag) return;
+        current_phase() = previous;
+        phase_profile(phase).nanos[phase].fetch_add((int64) (time_by(start) * 1e9), std::memory_order_relaxed);
+    }
+
+    phase_timer(const phase_timer &) = delete;
+
+    phase_timer &operator=(const phase_timer &) = delete;
+
+private:
+    profile_phase phase;
+    int32 previous;
+    double start;
+    perf_scope counters;
+};
+
+/*!
+ * @brief Write the record of a solver call with everything the profile has seen since its last record, and reset it.
+ *
+ * The record is a flat JSON object, e.g. {"solver":"IMM_ADVANCED","k":10,"A_size":1000,"time":1.5,
+ * "graph_load":0.8,...,"rr_sets":200000,...}, with the phase times in seconds. The graph load and the diffusion
+ * model are in the first record after them, whichever context writes it. With --perf, every phase also has its
+ * hardware counters and edges, e.g. "rr_sampling_cycles", -1 for a counter that the machine does not have.
+ * @param p : the profile
+ * @param solver : the name of the solver
+ * @param k : the number of seeds per participant
+ * @param A_size : the number of participants
+ * @param time : the running time of the solver call
+ */
+void profile_record(Profile &p, const std::string &solver, int32 k, int64 A_size, double time) {
+    if (!profile_flag) return;
+    Profile &g = graph_profile(), &total = profile_totals();
+    char buf[96];
+    std::string rec = "{\"solver\":\"" + solver + "\",\"k\":" + std::to_string(k) + ",\"A_size\":" +
+                      std::to_string(A_size);
+    snprintf(buf, sizeof(buf), ",\"time\":%.9g", time);
+    rec += buf;
+    for (int32 i = 0; i < PHASE_NUM; i++) {
+        int64 nanos = p.nanos[i].exchange(0) + g.nanos[i].exchange(0);
+        total.nanos[i] += nanos;
+        snprintf(buf, sizeof(buf), ",\"%s\":%.9g", phase_name[i], nanos * 1e-9);
+        rec += buf;
+    }
+    for (int32 i = 0; i < COUNTER_NUM; i++) {
+        int64 x = p.counts[i].exchange(0);
+        total.counts[i] += x;
+        rec += ",\"" + std::string(counter_name[i]) + "\":" + std::to_string(x);
+    }
+    for (int32 i = 0; perf_flag && i < PHASE_NUM; i++) {
+        int64 edges = p.edges[i].exchange(0) + g.edges[i].exchange(0);
+        total.edges[i] += edges;
+        rec += ",\"" + std::string(phase_name[i]) + "_edges\":" + std::to_string(edges);
+        for (int32 j = 0; j < PERF_NUM; j++) {
+            int64 x = p.perf[i][j].exchange(0) + g.perf[i][j].exchange(0);
+            total.perf[i][j] += x;
+            rec += ",\"" + std::string(phase_name[i]) + "_" + perf_name[j] + "\":" +
+                   std::to_string(perf_missing[j] ? -1 : x);
+        }
+    }
+    rec += "}\n";
+    if (!profile_out.is_open()) return;
+    std::lock_guard<std::mutex> lock(profile_mtx);
+    profile_out << rec;
+    profile_out.flush();
+}
+
+/*!
+ * @brief Print the time, IPC and misses per edge examined of every phase over all records of the process.
+ */
+void print_perf_summary() {
+    if (!perf_flag) return;
+    Profile &total = profile_totals();
+    printf("hardware counters per phase :\n");
+    for (int32 i = 0; i < PHASE_NUM; i++) {
+        double cycles = total.perf[i][PERF_CYCLES], edges = total.edges[i];
+        if (total.nanos[i] == 0 && cycles == 0) continue;
+        printf("\t%-16s time = %.3f", phase_name[i], total.nanos[i] * 1e-9);
+        if (cycles > 0 && !perf_missing[PERF_INSTRUCTIONS])
+            printf(" IPC = %.3f", total.perf[i][PERF_INSTRUCTIONS] / cycles);
+        if (edges > 0) {
+            if (!perf_missing[PERF_LLC_MISSES])
+                printf(" LLC misses / edge = %.4f", total.perf[i][PERF_LLC_MISSES] / edges);
+            if (!perf_missing[PERF_BRANCH_MISSES])
+                printf(" branch misses / edge = %.4f", total.perf[i][PERF_BRANCH_MISSES] / edges);
+            printf(" cycles / edge = %.2f", cycles / edges);
+        }
+        printf("\n");
+    }
+}
+
+#endif //EXP_PROFILE_H
@@ -0,0 +1,216 @@
+// Seed set evaluation from a shared pool of RI sets
+
+#ifndef EXP_RREVAL_H
+#define EXP_RREVAL_H
+
+#include "RRpool.h"
+#include "threadpool.h"
+
+/*!
+ * @brief An estimated influence spread with its 95% confidence interval.
+ */
+struct spread_estimate {
+    double value, lower, upper;
+};
+
+/*!
+ * @brief Evaluates seed sets by sigma(S) = n * Pr[a random RI set intersects S] on one pool of RI sets.
+ *
+ * The pool is sampled once per graph and diffusion model, independently of the RI sets used by the solvers.
+ * Up to 64 seed sets are evaluated in one pass : every node has a mask with bit j set if it is in the j-th
+ * seed set, and the scan of an RI set stops as soon as it has hit all of the seed sets.
+ */
+class RREvaluator {
+public:
+    /*!
+     * @brief Sample theta RI sets of the graph with its current diffusion model.
+     */
+    void build(Graph &graph, int64 theta) {
+        double cur = wall_clock();
+        own(graph);
+        states.resize(theta);
+        resample(graph, theta, [&](int64 i, RI_workspace &ws, vector<node> &RR) {
+            states[i] = ws.engine;
+            RI_sample(graph, ws.engine, RR, ws);
+        });
+        set_offset.clear(), set_ids.clear();
+        mask.assign(n, 0);
+        if (verbose_flag) {
+            printf("\tRI set pool built. theta = %ld, average size = %.2f, time = %.3f\n", (long) theta,
+                   (double) nodes.size() / theta, time_by(cur));
+        }
+    }
+
+    /*!
+     * @brief Check if the pool is sampled from the graph with its current diffusion model.
+     */
+    bool built_for(Graph &graph, int64 theta) const {
+        return owner == &graph && n == graph.n && m == graph.m && version == graph.version &&
+               model == graph.diff_model && deadline == graph.deadline && offsets.size() == theta + 1;
+    }
+
+    /*!
+     * @brief Bring the pool up to date with a change of the graph that keeps n, see refresh_RR_sets.
+     * The sets that contain a dirty node are sampled again from their states, the others are kept.
+     * @param graph : the graph after the change
+     * @param dirty : the nodes whose in-edges have changed
+     * @return : number of sets sampled again
+     */
+    int64 refresh(Graph &graph, const vector<node> &dirty) {
+        double cur = wall_clock();
+        vector<bool> is_dirty(n, false);
+        for (node u : dirty) is_dirty[u] = true;
+        vector<uint32_t> old_nodes;
+        vector<int64> old_offsets;
+        nodes.swap(old_nodes), offsets.swap(old_offsets);
+        std::atomic<int64> stale{0};
+        own(graph);
+        resample(graph, size_of(old_offsets), [&](int64 i, RI_workspace &ws, vector<node> &RR) {
+            int64 j = old_offsets[i];
+            while (j < old_offsets[i + 1] && !is_dirty[old_nodes[j]]) j++;
+            if (j == old_offsets[i + 1]) {
+                RR.assign(old_nodes.begin() + old_offsets[i], old_nodes.begin() + old_offsets[i + 1]);
+                return;
+            }
+            stale++;
+            std::minstd_rand engine = states[i];
+            RI_sample(graph, engine, RR, ws);
+        });
+        if (!set_offset.empty()) build_index();
+        if (verbose_flag) {
+            printf("\tRI set pool refreshed. sampled again = %ld / %ld, time = %.3f\n", (long) stale.load(),
+                   (long) size(), time_by(cur));
+        }
+        return stale;
+    }
+
+    /*!
+     * @brief Evaluate any number of seed sets on the pool, 64 of them per pass.
+     * The masks are shared, so concurrent calls are run one at a time.
+     * @param sets : the seed sets
+     * @return : the estimated spread of every seed set
+     */
+    vector<spread_estimate> evaluate(const vector<vector<node>> &sets) {
+        std::lock_guard<std::mutex> lock(mtx);
+        vector<spread_estimate> res;
+        for (int64 first = 0; first < sets.size(); first += 64) {
+            int64 num = min((int64) 64, (int64) sets.size() - first);
+            for (int64 j = 0; j < num; j++)
+                for (node u : sets[first + j]) mask[u] |= 1ull << j;
+            vector<int64> hits = scan(num);
+            for (int64 j = 0; j < num; j++)
+                for (node u : sets[first + j]) mask[u] = 0;
+            auto theta = (double) offsets.size() - 1;
+            for (int64 j = 0; j < num; j++) {
+                double p = hits[j] / theta, half = 1.96 * sqrt(p * (1 - p) / theta);
+                res.emplace_back(spread_estimate{p * n, max(0.0, p - half) * n, min(1.0, p + half) * n});
+            }
+        }
+        return res;
+    }
+
+    /// number of RI sets
+    int64 size() const { return (int64) offsets.size() - 1; }
+
+    /*!
+     * @brief Build the inverted index of the pool : the RI sets that contain each node, by one counting sweep.
+     * The coverage of a node is then the length of its list.
+     */
+    void build_index() {
+        set_offset.assign(n + 1, 0);
+        for (uint32_t u : nodes) set_offset[u + 1]++;
+        for (node u = 0; u < n; u++) set_offset[u + 1] += set_offset[u];
+        set_ids.resize(nodes.size());
+        vector<int64> fill(set_offset.begin(), set_offset.end() - 1);
+        for (int64 i = 0; i < size(); i++)
+            for (int64 j = offsets[i]; j < offsets[i + 1]; j++) set_ids[fill[nodes[j]]++] = (uint32_t) i;
+    }
+
+    /// number of RI sets that contain u, needs build_index
+    int64 coverage(node u) const { return set_offset[u + 1] - set_offset[u]; }
+
+    /// the RI sets that contain u, needs build_index
+    const uint32_t *sets_begin(node u) const { return set_ids.data() + set_offset[u]; }
+
+    const uint32_t *sets_end(node u) const { return set_ids.data() + set_offset[u + 1]; }
+
+private:
+    vector<uint32_t> nodes, set_ids;
+    vector<int64> offsets, set_offset;
+    vector<uint64_t> mask;
+    vector<std::minstd_rand> states;
+    std::mutex mtx;
+    const Graph *owner = nullptr;
+    node n = 0;
+    int64 m = 0, deadline = 0, version = 0;
+    model_type model = NONE;
+
+    void own(Graph &graph) {
+        owner = &graph, n = graph.n, m = graph.m, version = graph.version;
+        model = graph.diff_model, deadline = graph.deadline;
+    }
+
+    static int64 size_of(const vector<int64> &offsets) { return (int64) offsets.size() - 1; }
+
+    /// nodes and offsets = the theta sets given by sample(i, ws, RR) on the thread pool, in the order of i
+    template<class Sample>
+    void resample(Graph &graph, int64 theta, Sample sample) {
+        ThreadPool &pool = thread_pool();
+        int64 chunks = (int64) pool.size() * 4;
+        vector<vector<uint32_t>> part_nodes(chunks);
+        vector<vector<int64>> part_sizes(chunks);
+        pool.parallel_for(chunks, [&](int32 tid, int64 c) {
+            RI_workspace &ws = thread_workspace();
+            ws.resize(graph.n);
+            vector<node> RR;
+            for (int64 i = theta * c / chunks; i < theta * (c + 1) / chunks; i++) {
+                sample(i, ws, RR);
+                for (node u : RR) part_nodes[c].emplace_back((uint32_t) u);
+                part_sizes[c].emplace_back(RR.size());
+            }
+        });
+        nodes.clear();
+        offsets.assign(1, 0);
+        for (int64 c = 0; c < chunks; c++) {
+            nodes.insert(nodes.end(), part_nodes[c].begin(), part_nodes[c].end());
+            for (int64 s : part_sizes[c]) offsets.emplace_back(offsets.back() + s);
+            vector<uint32_t>().swap(part_nodes[c]);
+        }
+    }
+
+    /// hits[j] : number of RI sets that intersect the j-th seed set of the current masks
+    vector<int64> scan(int64 num) {
+        ThreadPool &pool = thread_pool();
+        uint64_t all = num == 64 ? ~0ull : (1ull << num) - 1;
+        auto theta = (int64) offsets.size() - 1;
+        int64 chunks = (int64) pool.size() * 4;
+        vector<vector<int64>> cnt(chunks, vector<int64>(num, 0));
+        pool.parallel_for(chunks, [&](int32 tid, int64 c) {
+            for (int64 i = theta * c / chunks; i < theta * (c + 1) / chunks; i++) {
+                uint64_t hit = 0;
+                for (int64 j = offsets[i]; j < offsets[i + 1] && hit != all; j++) hit |= mask[nodes[j]];
+                for (; hit; hit &= hit - 1) cnt[c][__builtin_ctzll(hit)]++;
+            }
+        });
+        vector<int64> hits(num, 0);
+        for (auto &x : cnt)
+            for (int64 j = 0; j < num; j++) hits[j] += x[j];
+        return hits;
+    }
+};
+
+///number of RI sets of the evaluation pool
+int64 eval_RR_sets = 1000000;
+RREvaluator rr_evaluator;
+
+/*!
+ * @brief The evaluation pool of the graph, sampled at the first use and shared by all solver contexts.
+ */
+RREvaluator &rr_evaluator_of(Graph &graph) {
+    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!rr_evaluator.built_for(graph, eval_RR_sets)) rr_evaluator.build(graph, eval_RR_sets);
+    return rr_evaluator;
+}
+
+#endif //EXP_RREVAL_H
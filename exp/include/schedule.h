@@ -0,0 +1,250 @@
+// Experiment sweep : the tasks of Run_simulation on a pool of solver contexts
+
+#ifndef EXP_SCHEDULE_H
+#define EXP_SCHEDULE_H
+
+#include "checkpoint.h"
+#include <sstream>
+#include <thread>
+#include <condition_variable>
+#include <unistd.h>
+
+/*!
+ * @brief The resident memory of the process in bytes, 0 if it cannot be read.
+ */
+int64 resident_memory() {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == nullptr) return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+    return (int64) resident * sysconf(_SC_PAGESIZE);
+}
+
+/*!
+ * @brief Runs the sweep of Run_simulation as independent tasks on sweep_jobs solver contexts.
+ *
+ * A task is one solver on one participant set with one k. The participant sets are drawn before the sweep starts,
+ * so every task only reads the graph and its own set. The tasks are started in the order of the sequential sweep,
+ * and a new task is not started while the resident memory exceeds sweep_memory_limit, unless no task is running.
+ * The logs of a task are kept until all the tasks before it are done, and the results are added up in the same
+ * order, so the output and the tables do not depend on the order the tasks finish.
+ *
+ * With a checkpoint, the participant sets are shared with the earlier runs of the same sweep, every finished task
+ * is saved, and a task that is already in the checkpoint is read from it instead of being solved again. The seed
+ * sets of the rr evaluator are evaluated again on the pool of the current run. A task of another shard that is not
+ * in the checkpoint is left out, and the tables are only printed when all the tasks of a size are there.
+ */
+class SweepScheduler {
+public:
+    SweepScheduler(Graph &graph, vector<node> &A_batch, vector<int32> &k_batch, vector<IM_solver> &solver_batch,
+                   int32 rounds, SweepCheckpoint *checkpoint = nullptr)
+            : graph(graph), A_batch(A_batch), k_batch(k_batch), solver_batch(solver_batch), rounds(rounds),
+              checkpoint(checkpoint) {
+        participants.assign(A_batch.size(), vector<vector<node>>(rounds));
+        overlap_ratio.assign(A_batch.size(), 0);
+        for (int64 a = 0; a < A_batch.size(); a++)
+            for (int32 r = 0; r < rounds; r++) generate_seed(graph, participants[a][r], A_batch[a]);
+        if (checkpoint) checkpoint->sync_participants(participants);
+        for (int64 a = 0; a < A_batch.size(); a++)
+            for (int32 r = 0; r < rounds; r++)
+                overlap_ratio[a] += estimate_neighbor_overlap(graph, participants[a][r]) / rounds;
+        tasks.resize(A_batch.size() * rounds * k_batch.size() * solver_batch.size());
+        int64 id = 0;
+        for (int32 a = 0; a < A_batch.size(); a++)
+            for (int32 r = 0; r < rounds; r++)
+                for (int32 ki = 0; ki < k_batch.size(); ki++)
+                    for (int32 si = 0; si < solver_batch.size(); si++)
+                        tasks[id].a = a, tasks[id].round = r, tasks[id].ki = ki, tasks[id++].si = si;
+    }
+
+    /*!
+     * @brief Run all the tasks and print the tables of every participant size once its tasks are done.
+     */
+    void run() {
+        //the evaluation pool is shared by all tasks, so it is sampled with all threads before they start
+        if (evaluator == "rr") rr_evaluator_of(graph);
+        auto jobs = (int32) min((int64) sweep_jobs, (int64) tasks.size());
+        vector<std::unique_ptr<Context>> contexts;
+        for (int32 j = 0; j < jobs; j++)
+            contexts.emplace_back(new Context(max(1, num_threads / jobs), discard, discard));
+        vector<std::thread> workers;
+        for (int32 j = 0; j < jobs; j++) workers.emplace_back(&SweepScheduler::worker, this, std::ref(*contexts[j]));
+        for (auto &t : workers) t.join();
+    }
+
+private:
+    struct sweep_task {
+        int32 a = 0, round = 0, ki = 0, si = 0;
+        vector<node> seeds;
+        double time = 0, value = 0;
+        ///the log and the result file lines of the task
+        string log, out;
+        ///missing : the task belongs to another shard and is not in the checkpoint
+        bool done = false, missing = false;
+    };
+
+    /// sums over the rounds of one participant size, [ki][si], and the number of its missing tasks
+    struct sweep_table {
+        vector<vector<double>> result, timer, seedSize;
+        int64 missing = 0;
+    };
+
+    Graph &graph;
+    vector<node> &A_batch;
+    vector<int32> &k_batch;
+    vector<IM_solver> &solver_batch;
+    int32 rounds;
+    SweepCheckpoint *checkpoint;
+    vector<vector<vector<node>>> participants;
+    vector<double> overlap_ratio;
+    vector<sweep_task> tasks;
+    sweep_table table;
+    std::ostream discard{nullptr};
+    std::mutex mtx, flush_mtx;
+    std::condition_variable cv_done;
+    int64 next_task = 0, flushed = 0;
+    int32 running = 0;
+
+    void worker(Context &context) {
+        while (true) {
+            int64 id;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                while (sweep_memory_limit > 0 && running > 0 && resident_memory() > (sweep_memory_limit << 20))
+                    cv_done.wait_for(lock, std::chrono::milliseconds(100));
+                if (next_task >= tasks.size()) return;
+                id = next_task++;
+                running++;
+            }
+            run_task(id, context);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                running--;
+            }
+            cv_done.notify_all();
+            std::lock_guard<std::mutex> lock(flush_mtx);
+            tasks[id].done = true;
+            while (flushed < tasks.size() && tasks[flushed].done) flush(flushed++);
+        }
+    }
+
+    void run_task(int64 id, Context &context) {
+        sweep_task &t = tasks[id];
+        std::ostringstream log, res;
+        context.log = &log, context.out = &res;
+        {
+            context_scope scope(context);
+            vector<node> A = participants[t.a][t.round];
+            if (t.ki == 0 && t.si == 0) {
+                print_set(A, "active participant: "), log << '\n';
+                print_set_f(A, "active participant: "), res << '\n';
+            }
+            if (t.si == 0) {
+                log << "Working on A_size = " << A_batch[t.a] << ", round = " << t.round + 1 << ", k = "
+                    << k_batch[t.ki] << endl;
+                res << "Working on A_size = " << A_batch[t.a] << ", round = " << t.round + 1 << ", k = "
+                    << k_batch[t.ki] << endl;
+            }
+            const string &name = solver_name[solver_batch[t.si]];
+            if (checkpoint && checkpoint->load_task(id, t.seeds, t.time, t.value)) {
+                print_set(t.seeds, " Seed set of " + name + " from checkpoint: "), log << '\n';
+            } else if (id % shard_count != shard_id) {
+                t.missing = true;
+                log << " " << name << " is left to another shard" << endl;
+            } else {
+                t.time = solvers(graph, k_batch[t.ki], A, t.seeds, solver_batch[t.si]);
+                t.value = evaluator == "rr" ? -1 : evaluate_seeds(graph, t.seeds);
+                if (checkpoint) checkpoint->save_task(id, t.seeds, t.time, t.value);
+            }
+        }
+        context.log = &discard, context.out = &discard;
+        t.log = log.str(), t.out = res.str();
+    }
+
+    /*!
+     * @brief Print the task and add up its results, called in the order of the tasks.
+     */
+    void flush(int64 id) {
+        sweep_task &t = tasks[id];
+        if (t.round == 0 && t.ki == 0 && t.si == 0) {
+            auto K = k_batch.size(), S = solver_batch.size();
+            table.result.assign(K, vector<double>(S, 0));
+            table.timer.assign(K, vector<double>(S, 0));
+            table.seedSize.assign(K, vector<double>(S, 0));
+            table.missing = 0;
+        }
+        cout << t.log;
+        out << t.out;
+        if (t.missing) table.missing++;
+        else table.timer[t.ki][t.si] += t.time / rounds;
+        if (!t.missing) table.seedSize[t.ki][t.si] += (double) t.seeds.size() / rounds;
+        if (evaluator != "rr" && !t.missing) table.result[t.ki][t.si] += t.value / rounds;
+        if (t.si + 1 < solver_batch.size()) return;
+        if (evaluator == "rr") {
+            //all outputs of this k are evaluated in one pass over the shared pool
+            vector<vector<node>> outputs;
+            vector<int32> present;
+            for (int64 i = first_of(id); i <= id; i++)
+                if (!tasks[i].missing) outputs.emplace_back(tasks[i].seeds), present.emplace_back(tasks[i].si);
+            vector<spread_estimate> est = rr_evaluator_of(graph).evaluate(outputs);
+            for (int64 j = 0; j < present.size(); j++) {
+                int32 i = present[j];
+                table.result[t.ki][i] += est[j].value / rounds;
+                printf("\t%s : spread = %.3f, 95%% CI = [%.3f, %.3f]\n", solver_name[solver_batch[i]].c_str(),
+                       est[j].value, est[j].lower, est[j].upper);
+                out << "\t" << solver_name[solver_batch[i]] << " : spread = " << est[j].value << ", 95% CI = ["
+                    << est[j].lower << ", " << est[j].upper << "]\n";
+            }
+        }
+        for (int64 i = first_of(id); i <= id; i++) tasks[i].seeds = vector<node>();
+        if (t.round + 1 == rounds && t.ki + 1 == k_batch.size()) print_table(t.a);
+    }
+
+    /// the first task with the same participant set and k as the task id
+    int64 first_of(int64 id) {
+        return id + 1 - (int64) solver_batch.size();
+    }
+
+    void print_table(int32 a) {
+        if (table.missing > 0) {
+            cout << "Size " << A_batch[a] << " : " << table.missing << " tasks are left to other shards, "
+                 << "run again with the same checkpoint when they are done to print the table" << endl;
+            return;
+        }
+        cout << "\"*************\\nSize " << A_batch[a] << " DONE!\n*************\n";
+        for (std::ostream *os : {(std::ostream *) &cout, (std::ostream *) &out}) {
+            *os << "Active participant size = " << A_batch[a] << endl;
+            *os << "Mean overlap ratio = " << overlap_ratio[a] << endl;
+            for (int32 ki = 0; ki < k_batch.size(); ki++) {
+                *os << "\tk = " << k_batch[ki] << endl;
+                for (int32 si = 0; si < solver_batch.size(); si++) {
+                    *os << "\t\tseed quality of " << solver_name[solver_batch[si]] << " = " << table.result[ki][si];
+                    *os << " time = " << table.timer[ki][si];
+                    *os << " size = " << table.seedSize[ki][si] << endl;
+                }
+            }
+        }
+    }
+};
+
+void Run_simulation(vector<node> &A_batch, vector<int32> &k_batch, vector<IM_solver> &solver_batch, model_type type,
+                    int32 rounds = 3) {
+    fstream file_eraser("../output/result.out", ios::out);
+    file_eraser.close();
+    out.open("../output/result.out", ios::app);
+    //load graph from absolute path
+    Graph G(graphFilePath, DIRECTED_G);
+
+    //set diffusion model
+    G.set_diffusion_model(type, 15);
+
+    std::unique_ptr<SweepCheckpoint> checkpoint;
+    if (!checkpoint_dir.empty())
+        checkpoint.reset(new SweepCheckpoint(checkpoint_dir, sweep_config(G, A_batch, k_batch, solver_batch, rounds)));
+    SweepScheduler scheduler(G, A_batch, k_batch, solver_batch, rounds, checkpoint.get());
+    scheduler.run();
+    out.close();
+}
+
+#endif //EXP_SCHEDULE_H
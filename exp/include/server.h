@@ -0,0 +1,360 @@
+// Query server : the graph and the evaluation pool stay resident between requests
+
+#ifndef EXP_SERVER_H
+#define EXP_SERVER_H
+
+#include "top.h"
+#include "update.h"
+#include "json.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cerrno>
+#include <map>
+#include <deque>
+#include <condition_variable>
+#include <poll.h>
+#include <shared_mutex>
+
+/*!
+ * @brief A query : find the seeds of the participant set A with k seeds per participant by the solver.
+ */
+struct bim_query {
+    string id = "null";
+    vector<node> A;
+    int32 k = 0;
+    IM_solver solver = 0;
+};
+
+/*!
+ * @brief Parse a query line {"id": 1, "A": [3, 5, 8], "k": 2, "solver": "IMM_ADVANCED"}, where solver is a name
+ * of solver_name or its number and id is optional.
+ * @param line : the line
+ * @param graph : the graph, to check the nodes
+ * @param q : returns the query, q.id is set whenever the line is a JSON object
+ * @param req : returns the JSON object
+ * @param err : returns the reason if the line is not a valid query
+ * @return : true if the line is a valid query
+ */
+bool parse_query(const string &line, Graph &graph, bim_query &q, json_object &req, string &err) {
+    q = bim_query();
+    if (!parse_json_object(line, req, err)) return false;
+    if (req.count("id")) {
+        auto &v = req["id"];
+        q.id = v.kind == json_value::STR ? json_string(v.str) : v.kind == json_value::NUM ? json_number(v.num) : q.id;
+    }
+    if (!req.count("A") || req["A"].kind != json_value::ARR) return err = "A must be an array of nodes", false;
+    if (!req.count("k") || req["k"].kind != json_value::NUM || req["k"].num < 1 || req["k"].num > graph.n ||
+        req["k"].num != floor(req["k"].num))
+        return err = "k must be a positive integer no larger than n", false;
+    for (double x : req["A"].arr) {
+        if (x < 0 || x >= graph.n || x != floor(x)) return err = "node out of range: " + json_number(x), false;
+        q.A.emplace_back((node) x);
+    }
+    int64 solver = -1;
+    if (req.count("solver") && req["solver"].kind == json_value::NUM) solver = (int64) req["solver"].num;
+    else if (req.count("solver") && req["solver"].kind == json_value::STR) {
+        string name = req["solver"].str;
+        transform(name.begin(), name.end(), name.begin(), ::toupper);
+        solver = find(solver_name, solver_name + SOLVER_NUM, name) - solver_name;
+    }
+    if (solver < 0 || solver >= SOLVER_NUM) return err = "unknown solver", false;
+    q.k = (int32) req["k"].num;
+    q.solver = (IM_solver) solver;
+    return true;
+}
+
+/// the reply line of a solved query
+string query_reply(const bim_query &q, const vector<node> &seeds, const spread_estimate &est, double solve_time,
+                   double eval_time) {
+    return "{\"id\":" + q.id + ",\"solver\":" + json_string(solver_name[q.solver]) + ",\"seeds\":" +
+           json_array(seeds) + ",\"spread\":" + json_number(est.value) + ",\"lower\":" + json_number(est.lower) +
+           ",\"upper\":" + json_number(est.upper) + ",\"solve_time\":" + json_number(solve_time) +
+           ",\"eval_time\":" + json_number(eval_time) + "}";
+}
+
+/// the reply line of a query that failed
+string query_error(const string &id, const string &reason) {
+    return "{\"id\":" + id + ",\"error\":" + json_string(reason) + "}";
+}
+
+/*!
+ * @brief Parse the edges of an update request, given as flat arrays "insert": [u1, v1, u2, v2, ...] and "delete".
+ * @param req : the request
+ * @param key : "insert" or "delete"
+ * @param graph : the graph, to check the nodes. New nodes are not accepted.
+ * @param edges : returns the edges
+ * @param err : returns the reason if the edges are not valid
+ * @return : true if the edges are valid, or the key is absent
+ */
+bool parse_edges(json_object &req, const string &key, Graph &graph, vector<pair<node, node>> &edges, string &err) {
+    edges.clear();
+    if (!req.count(key)) return true;
+    if (req[key].kind != json_value::ARR || req[key].arr.size() % 2 != 0)
+        return err = key + " must be an array of node pairs", false;
+    auto &a = req[key].arr;
+    for (double x : a)
+        if (x < 0 || x >= graph.n || x != floor(x)) return err = "node out of range: " + json_number(x), false;
+    for (size_t i = 0; i < a.size(); i += 2) edges.emplace_back((node) a[i], (node) a[i + 1]);
+    return true;
+}
+
+/*!
+ * @brief The server of the queries.
+ *
+ * A request is one query line, see parse_query. The reply is one line
+ * {"id": 1, "seeds": [...], "spread": x, "lower": x, "upper": x, "solve_time": t, "eval_time": t}
+ * with the 95% confidence interval of the spread from the evaluation pool, or {"id": 1, "error": "..."}.
+ * {"cmd": "update", "insert": [u1, v1, ...], "delete": [u1, v1, ...]} changes the edges (see update_graph) and
+ * replies with the new version of the graph and what has been sampled again. {"cmd": "quit"} stops the server.
+ *
+ * In the socket mode, one thread polls the connections and queues their request lines, and serve_workers workers
+ * answer them, each with its own solver context of num_threads / serve_workers threads. So the queries of different
+ * connections are solved concurrently on the same graph, and an idle connection only holds its socket. A connection
+ * has at most one request in the queue or in progress, so its replies keep the order of its requests. At most
+ * serve_connections connections are open, the others get an error and are closed. An update waits for the queries
+ * in progress and runs alone.
+ */
+class QueryServer {
+public:
+    explicit QueryServer(Graph &graph) : graph(graph) {}
+
+    /*!
+     * @brief Answer one request line.
+     * @param line : the request
+     * @param quit : set to true if the request stops the server
+     * @param context : the solver context of the connection
+     * @return : the reply line without the newline
+     */
+    string handle(const string &line, bool &quit, Context &context) {
+        json_object req;
+        bim_query q;
+        string err;
+        if (!parse_query(line, graph, q, req, err)) {
+            if (!req.count("cmd")) return query_error(q.id, err);
+            if (req["cmd"].str == "update") return update(req, q.id);
+            if (req["cmd"].str != "quit") return query_error(q.id, "unknown cmd");
+            quit = true;
+            return "{\"id\":" + q.id + ",\"ok\":true}";
+        }
+        vector<node> seeds;
+        double solve_time, eval_time;
+        spread_estimate est;
+        {
+            //queries only read the graph, updates wait until no query is in progress
+            std::shared_lock<std::shared_timed_mutex> lock(graph_mtx);
+            solve_time = solvers(context, graph, q.k, q.A, seeds, q.solver);
+            double cur = wall_clock();
+            est = rr_evaluator_of(graph).evaluate(vector<vector<node>>(1, seeds))[0];
+            eval_time = time_by(cur);
+        }
+        return query_reply(q, seeds, est, solve_time, eval_time);
+    }
+
+    /*!
+     * @brief Answer the requests of stdin.
+     * @param reply_fd : the file descriptor of the replies, stdout has been redirected to stderr for the log
+     */
+    void serve_stdio(int reply_fd) {
+        FILE *reply = fdopen(reply_fd, "w");
+        string line;
+        bool quit = false;
+        while (!quit && getline(cin, line)) {
+            if (line.empty()) continue;
+            string res = handle(line, quit, default_context());
+            fprintf(reply, "%s\n", res.c_str());
+            fflush(reply);
+        }
+        fclose(reply);
+    }
+
+    /*!
+     * @brief Answer the requests of the clients of a UNIX socket on serve_workers workers.
+     * @param path : the path of the socket
+     */
+    void serve_socket(const string &path) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "(get error) socket path too long: " << path << std::endl;
+            std::exit(-1);
+        }
+        strcpy(addr.sun_path, path.c_str());
+        int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path.c_str());
+        if (listen_fd < 0 || bind(listen_fd, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(listen_fd, 64) != 0 ||
+            pipe(wake_fd) != 0) {
+            std::cerr << "(get error) cannot listen on socket: " << path << std::endl;
+            std::exit(-1);
+        }
+        cout << "server listening on " << path << " with " << serve_workers << " workers" << endl;
+        vector<std::unique_ptr<Context>> contexts;
+        vector<std::thread> workers;
+        for (int32 w = 0; w < serve_workers; w++) {
+            //the seeds are logged to stdout, the result file is not written in this mode
+            contexts.emplace_back(new Context(max(1, num_threads / serve_workers), std::cout, discard));
+            workers.emplace_back(&QueryServer::worker, this, std::ref(*contexts[w]));
+        }
+        std::map<int, client> clients;
+        vector<pollfd> fds;
+        while (!stopping) {
+            fds.assign(1, pollfd{listen_fd, POLLIN, 0});
+            fds.emplace_back(pollfd{wake_fd[0], POLLIN, 0});
+            //a connection with a request in progress is not read until it is answered
+            for (auto &c : clients)
+                if (!c.second.busy) fds.emplace_back(pollfd{c.first, POLLIN, 0});
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (fds[1].revents) {
+                char tmp[64];
+                if (read(wake_fd[0], tmp, sizeof(tmp)) < 0) break;
+                vector<pair<int, bool>> finished;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    finished.swap(done);
+                }
+                for (auto &f : finished) {
+                    auto it = clients.find(f.first);
+                    it->second.busy = false;
+                    if (f.second) close_client(clients, it);
+                    else dispatch(it->second);
+                }
+            }
+            for (size_t i = 2; i < fds.size(); i++) {
+                if (!fds[i].revents) continue;
+                auto it = clients.find(fds[i].fd);
+                char chunk[4096];
+                ssize_t got = read(fds[i].fd, chunk, sizeof(chunk));
+                if (got <= 0) close_client(clients, it);
+                else it->second.buf.append(chunk, got), dispatch(it->second);
+            }
+            if (fds[0].revents) {
+                int fd = accept(listen_fd, nullptr, nullptr);
+                if (fd < 0) continue;
+                if (clients.size() >= serve_connections) {
+                    string res = query_error("null", "too many connections") + "\n";
+                    send(fd, res.data(), res.size(), MSG_NOSIGNAL);
+                    close(fd);
+                    continue;
+                }
+                clients[fd].fd = fd;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv_jobs.notify_all();
+        for (auto &t : workers) t.join();
+        for (auto &c : clients) close(c.first);
+        close(listen_fd), close(wake_fd[0]), close(wake_fd[1]);
+        unlink(path.c_str());
+        cout << "server stopped" << endl;
+    }
+
+private:
+    /// a connection : its socket, the bytes read but not handled yet, and whether a request is queued or in progress
+    struct client {
+        int fd = -1;
+        string buf;
+        bool busy = false;
+    };
+
+    Graph &graph;
+    std::shared_timed_mutex graph_mtx;
+    std::mutex mtx;
+    std::condition_variable cv_jobs;
+    ///jobs : the request lines that wait for a worker, done : the connections answered, and whether they are broken
+    std::deque<pair<int, string>> jobs;
+    vector<pair<int, bool>> done;
+    ///the workers wake up the polling thread by this pipe
+    int wake_fd[2] = {-1, -1};
+    std::atomic<bool> stopping{false};
+    std::ostream discard{nullptr};
+
+    /// queue the next request line of the connection, if it has a complete one
+    void dispatch(client &c) {
+        size_t pos;
+        while ((pos = c.buf.find('\n')) != string::npos) {
+            string line = c.buf.substr(0, pos);
+            c.buf.erase(0, pos + 1);
+            if (line.empty()) continue;
+            c.busy = true;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                jobs.emplace_back(c.fd, line);
+            }
+            cv_jobs.notify_one();
+            return;
+        }
+    }
+
+    void close_client(std::map<int, client> &clients, std::map<int, client>::iterator it) {
+        close(it->first);
+        clients.erase(it);
+    }
+
+    void worker(Context &context) {
+        while (true) {
+            pair<int, string> job;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_jobs.wait(lock, [&]() { return stopping || !jobs.empty(); });
+                if (stopping) return;
+                job = jobs.front();
+                jobs.pop_front();
+            }
+            bool quit = false, broken = false;
+            string res = handle(job.second, quit, context) + "\n";
+            for (size_t sent = 0; sent < res.size();) {
+                ssize_t w = send(job.first, res.data() + sent, res.size() - sent, MSG_NOSIGNAL);
+                if (w <= 0) {
+                    broken = true;
+                    break;
+                }
+                sent += w;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                done.emplace_back(job.first, broken);
+                if (quit) stopping = true;
+            }
+            if (quit) cv_jobs.notify_all();
+            ssize_t woke = write(wake_fd[1], "w", 1);
+            (void) woke;
+        }
+    }
+
+    string update(json_object &req, const string &id) {
+        vector<pair<node, node>> insertions, deletions;
+        string err;
+        if (!parse_edges(req, "insert", graph, insertions, err) || !parse_edges(req, "delete", graph, deletions, err))
+            return query_error(id, err);
+        std::lock_guard<std::shared_timed_mutex> lock(graph_mtx);
+        update_report r = update_graph(graph, insertions, deletions);
+        return "{\"id\":" + id + ",\"ok\":true,\"version\":" + json_number(graph.version) + ",\"m\":" +
+               json_number(graph.m) + ",\"inserted\":" + json_number(r.inserted) + ",\"deleted\":" +
+               json_number(r.deleted) + ",\"dirty\":" + json_number(r.dirty) + ",\"resampled\":" +
+               json_number(r.resampled) + ",\"kept\":" + json_number(r.kept) + ",\"time\":" + json_number(r.time) +
+               "}";
+    }
+};
+
+/*!
+ * @brief --serve mode : load the graph and build the evaluation pool once, then answer requests.
+ * @param type : the diffusion model
+ */
+void Serve(model_type type) {
+    Graph G(graphFilePath, DIRECTED_G);
+    G.set_diffusion_model(type, 15);
+    QueryServer server(G);
+    double cur = wall_clock();
+    rr_evaluator_of(G);
+    cout << "graph and evaluation pool ready, time = " << time_by(cur) << endl;
+    if (serve_path == "stdio") server.serve_stdio(serve_reply_fd);
+    else server.serve_socket(serve_path);
+}
+
+#endif //EXP_SERVER_H
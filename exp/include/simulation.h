@@ -6,6 +6,10 @@
 #define EXP_SIMULATION_H
 
 #include "graph.h"
+#include "bitsim.h"
+#include "snapshot.h"
+#include "sketch.h"
+#include "context.h"
 #include <set>
 #include <algorithm>
 
@@ -26,143 +30,355 @@ void generate_seed(Graph &graph, vector<node> &S, node size = 1) {
     delete[] tmp;
 }
 
-/// @brief Marks the point that was activated in the MC simulation
-bool active[MAX_NODE_SIZE];
+/*!
+ * @brief Cascade state of one MC simulation thread.
+ *
+ * active : marks the point that was activated in the MC simulation, all false between two rounds
+ * engine : the random stream of this thread
+ */
+struct MC_state {
+    vector<bool> active;
+    vector<node> new_active, A, new_ones;
+    ///wheel[t] : targets of the edges that meet at round t (IC-M)
+    vector<vector<node>> wheel;
+    std::minstd_rand engine;
+    std::uniform_real_distribution<double> real_distrib;
+    ///number of meetings sampled in IC-M, and of out-edges examined since they were last counted in the profile
+    int64 meet_time = 0, edges = 0;
+    ///activation times and buckets of MC_world_traverse, time[v] = -1 if v is inactive
+    vector<int64> time;
+    vector<node> reached;
+    vector<vector<node>> buckets;
+
+    MC_state() : engine(rd__()), real_distrib(0.0, 1.0) {}
+
+    void resize(node n) {
+        if (active.size() < n) active.assign(n, false);
+    }
+
+    inline double random_real() {
+        return real_distrib(engine);
+    }
+};
 
 /*!
- * @brief run MC simulation to evaluate the influence spread.
- * @param graph : the graph that define propagation models(IC)
+ * @brief The cascade state of the calling thread, shared by all solver contexts that run on it.
+ */
+MC_state &thread_MC_state() {
+    static thread_local MC_state st;
+    return st;
+}
+
+/*!
+ * @brief The bit-parallel state of the calling thread, shared by all solver contexts that run on it.
+ */
+BP_state &thread_BP_state() {
+    static thread_local BP_state st;
+    return st;
+}
+
+/*!
+ * @brief run one round of MC simulation.
+ * @param graph : the graph that define propagation models(IC or IC-M)
  * @param S : the seed set
- * @return the estimated value of influence spread
+ * @param st : the cascade state of the calling thread
+ * @return the number of activated nodes in this round
  */
-double MC_simulation(Graph &graph, vector<node> &S) {
-    double cur = clock();
-    int64 meet_time = 0; //Too large for int!
-    vector<node> new_active, A, new_ones;
-    vector<Edge> meet_nodes, meet_nodes_tmp;
-    double res = 0;
-    for (int64 i = 1; i <= MC_iteration_rounds; i++) {
-        if (graph.diff_model == IC) {
-            new_active = S, A = S;
-            for (node w : S) active[w] = true;
-            new_ones.clear();
-            while (!new_active.empty()) {
-                for (node u : new_active) {
-                    for (auto &edge : graph.g[u]) {
-                        node v = edge.v;
-                        if (active[v]) continue;
-                        bool success = (random_real() < edge.p);
-                        if (success) new_ones.emplace_back(v), active[v] = true;
-                    }
+int64 MC_round(Graph &graph, vector<node> &S, MC_state &st) {
+    auto &active = st.active;
+    auto &new_active = st.new_active, &A = st.A, &new_ones = st.new_ones;
+    int64 res = 0;
+    if (graph.diff_model == IC) {
+        new_active = S, A = S;
+        for (node w : S) active[w] = true;
+        new_ones.clear();
+        while (!new_active.empty()) {
+            for (node u : new_active) {
+                st.edges += (int64) graph.g[u].size();
+                for (auto &edge : graph.g[u]) {
+                    node v = edge.v;
+                    if (active[v]) continue;
+                    bool success = (st.random_real() < edge.p);
+                    if (success) new_ones.emplace_back(v), active[v] = true;
                 }
-                new_active = new_ones;
-                for (node u : new_ones) A.emplace_back(u);
-                new_ones.clear();
-            }
-            for (node u : A) active[u] = false;
-            res += (double) A.size() / MC_iteration_rounds;
-            A.clear();
-        } else if (graph.diff_model == IC_M) {
-            meet_nodes.clear();
-            new_active = S;
-            for (node w : S) active[w] = true;
-            for (int64 spread_rounds = 0; spread_rounds < graph.deadline; spread_rounds++) {
-                for (node u : new_active) {
-                    for (auto &edge : graph.g[u]) {
-                        if (active[edge.v]) continue;
-                        meet_nodes.emplace_back(edge);
-                    }
-                }
-                for (node u : new_active) A.emplace_back(u);
-                new_active.clear();
-                if (meet_nodes.empty()) break;
-                meet_nodes_tmp.clear();
-                for (auto &edge : meet_nodes) {
-                    if (!active[edge.v]) {
-                        meet_time++;
-                        bool meet_success = (random_real() < edge.m);
-                        if (meet_success) {
-                            bool activate_success = (random_real() < edge.p);
-                            if (activate_success) {
-                                new_active.emplace_back(edge.v);
-                                active[edge.v] = true;
-                            }
-                        } else {
-                            meet_nodes_tmp.emplace_back(edge);
-                        }
-                    }
-                }
-                meet_nodes = meet_nodes_tmp;
             }
+            new_active.swap(new_ones);
             for (node u : new_active) A.emplace_back(u);
-            for (node u : A) active[u] = false;
-            res += (double) A.size() / MC_iteration_rounds;
-            A.clear();
+            new_ones.clear();
         }
+        for (node u : A) active[u] = false;
+        res = A.size();
+        A.clear();
+    } else if (graph.diff_model == IC_M) {
+        //event-driven : the meeting round of an out-edge is sampled once when its source is activated,
+        //and the edge waits in wheel[round] for the target to be activated at the end of that round
+        auto &wheel = st.wheel;
+        if (wheel.size() < graph.deadline + 1) wheel.resize(graph.deadline + 1);
+        auto expand = [&](node u, int64 t) {
+            st.edges += (int64) graph.g[u].size();
+            for (auto &edge : graph.g[u]) {
+                if (active[edge.v] || edge.m <= 0) continue;
+                if (st.random_real() >= edge.p) continue;
+                st.meet_time++;
+                geometric_distribution<int> distribution(min(edge.m, 1.0));
+                int64 round = t + distribution(st.engine) + 1;
+                if (round <= graph.deadline) wheel[round].emplace_back(edge.v);
+            }
+        };
+        for (node w : S) active[w] = true, A.emplace_back(w);
+        for (node w : S) expand(w, 0);
+        for (int64 t = 1; t <= graph.deadline; t++) {
+            for (node v : wheel[t]) {
+                if (active[v]) continue;
+                active[v] = true;
+                A.emplace_back(v);
+                expand(v, t);
+            }
+            wheel[t].clear();
+        }
+        for (node u : A) active[u] = false;
+        res = A.size();
+        A.clear();
     }
-    if (verbose_flag) {
-        cout << "\t\tresult="  << res << " time=" << time_by(cur) << "meet time=" << meet_time << endl;
+    return res;
+}
+
+/*!
+ * @brief The meeting delay of the j-th out-going edge of u in a world given by its seed.
+ *
+ * The coins of an edge are a hash of the world and the edge, so the same world can be traversed again
+ * from other sources. The edge is live with probability p, and in IC-M its delay is Geometric(m) + 1.
+ * @return -1 if the edge is not live, 0 in IC, the delay in IC-M
+ */
+inline int64 MC_world_delay(Graph &graph, uint64_t world, node u, int64 j, Edge &edge) {
+    rng64 h(world ^ ((uint64_t) u * 0xD1B54A32D192ED03ull + (uint64_t) j));
+    if ((h() >> 11) * (1.0 / 9007199254740992.0) >= edge.p) return -1;
+    if (graph.diff_model == IC) return 0;
+    if (edge.m >= 1.0) return 1;
+    return 1 + (int64) floor(log(1.0 - (h() >> 11) * (1.0 / 9007199254740992.0)) / log(1.0 - edge.m));
+}
+
+/*!
+ * @brief Earliest-arrival traversal of a world from the sources at time 0, on top of the activation
+ * times in st.time. Only the nodes that the sources reach earlier are updated.
+ * @param graph : the graph that define propagation models(IC or IC-M)
+ * @param world : the seed of the world
+ * @param sources : the new sources
+ * @param st : the cascade state, st.time and st.reached are kept for the next traversal
+ * @return the number of newly activated nodes
+ */
+int64 MC_world_traverse(Graph &graph, uint64_t world, vector<node> &sources, MC_state &st) {
+    int64 horizon = graph.diff_model == IC_M ? graph.deadline : 0, res = 0;
+    if (st.time.size() < graph.n) st.time.assign(graph.n, -1);
+    if (st.buckets.size() < horizon + 1) st.buckets.resize(horizon + 1);
+    auto relax = [&](node v, int64 t) {
+        if (st.time[v] != -1 && st.time[v] <= t) return;
+        if (st.time[v] == -1) res++, st.reached.emplace_back(v);
+        st.time[v] = t;
+        st.buckets[t].emplace_back(v);
+    };
+    for (node w : sources) relax(w, 0);
+    for (int64 t = 0; t <= horizon; t++) {
+        auto &B = st.buckets[t];
+        for (int64 i = 0; i < B.size(); i++) {
+            node u = B[i];
+            if (st.time[u] != t) continue;
+            st.edges += (int64) graph.g[u].size();
+            for (int64 j = 0; j < graph.g[u].size(); j++) {
+                int64 d = MC_world_delay(graph, world, u, j, graph.g[u][j]);
+                if (d >= 0 && t + d <= horizon) relax(graph.g[u][j].v, t + d);
+            }
+        }
+        B.clear();
     }
     return res;
 }
 
+///rounds of the last estimation, and the total rounds of all estimations
+///(estimations may run concurrently on different threads, e.g. in enumeration_method)
+thread_local int64 MC_last_rounds;
+std::atomic<int64> MC_rounds_used(0);
+///number of spread estimations (MC, bit-parallel or lookahead) so far
+std::atomic<int64> MC_simulation_calls(0);
+///the adaptive estimator runs at least this many rounds before it checks its stopping rules
+const int64 MC_min_rounds = 128;
+
 /*!
- * @brief These global variables are used to assist the recursive functions.
- * No needs to be initialized.
+ * @brief Run a spread estimator in waves of batches on the thread pool.
+ *
+ * Without a relative error target and a threshold, one wave runs all MC_iteration_rounds rounds.
+ * Otherwise waves of growing size run until the half width of the 95% confidence interval of the mean
+ * is below MC_rel_error * mean, the upper confidence bound is below the threshold, or MC_iteration_rounds
+ * rounds are used. Partial sums are added up in batch order.
+ * @param batch : batch(tid, rounds, sum, sumsq) runs the given number of rounds and returns the sum and
+ * the sum of squares of the numbers of activated nodes
+ * @param batch_rounds : preferred number of rounds of a batch
+ * @param threshold : stop as soon as the upper confidence bound is below it, -1 for none
+ * @param upper : if not null, returns the upper confidence bound
+ * @return the estimated value of influence spread
  */
-int64 node_selected[MAX_NODE_SIZE];
-int64 neighbour_selected[MAX_NODE_SIZE];
-int64 stack_kS[MAX_NODE_SIZE], stack_kS_top;
+template<class Batch>
+double run_estimator(Batch batch, int64 batch_rounds, double threshold, double *upper) {
+    phase_timer timer(PHASE_MC_SIMULATION);
+    ThreadPool &pool = thread_pool();
+    bool adaptive = MC_rel_error > 0 || threshold >= 0;
+    int64 done = 0, wave = adaptive ? min(MC_iteration_rounds, max(MC_min_rounds, pool.size() * batch_rounds))
+                                    : MC_iteration_rounds;
+    double sum = 0, sumsq = 0, mean = 0, half = 0;
+    while (done < MC_iteration_rounds) {
+        int64 rounds = min(wave, MC_iteration_rounds - done);
+        int64 batches = max((int64) 1, min(rounds / batch_rounds, (int64) pool.size() * 4));
+        vector<int64> s(batches, 0), sq(batches, 0);
+        pool.parallel_for(batches, [&](int32 tid, int64 b) {
+            batch(tid, rounds * (b + 1) / batches - rounds * b / batches, s[b], sq[b]);
+        });
+        for (int64 b = 0; b < batches; b++) sum += s[b], sumsq += sq[b];
+        done += rounds;
+        mean = sum / done;
+        half = done > 1 ? 1.96 * sqrt(max(0.0, sumsq / done - mean * mean) / (done - 1)) : 0;
+        if (!adaptive) continue;
+        if (done >= MC_min_rounds && half <= MC_rel_error * mean) break;
+        if (done >= MC_min_rounds && mean + half < threshold) break;
+        wave = done;
+    }
+    if (upper) *upper = mean + half;
+    MC_last_rounds = done;
+    MC_rounds_used += done;
+    profile_count(COUNTER_MC_ROUNDS, done);
+    MC_simulation_calls++;
+    return mean;
+}
 
 /*!
- * @brief A recursive method for enumerating all possible S.
- * @param graph : the graph
- * @param S : the active participant set
- * @param V_n : a container to store all possible S
- * @param k0 : number of neighbours k of each node
- * @param k_now : Integer internal parameters, should initialize as 0
- * @param i_now : Integer internal parameters, should initialize as 0
- * @param it : Iterator internal parameters, should initialize as S.begin()
- * @param is_new : Boolean internal parameters, should initialize as true
+ * @brief run MC simulation to evaluate the influence spread.
+ *
+ * The rounds are split into batches that run on the thread pool, each thread with its own cascade state.
+ * @param graph : the graph that define propagation models(IC or IC-M)
+ * @param S : the seed set
+ * @param threshold : stop as soon as the upper confidence bound is below it, -1 for none
+ * @param upper : if not null, returns the upper confidence bound
+ * @return the estimated value of influence spread
  */
-void select_neighbours(Graph &graph, vector<node> &S, vector<vector<node> > &V_n, int64 k0, int64 k_now, int64 i_now,
-                       vector<node>::iterator it,
-                       bool is_new) {
-    if (it == S.end()) {
-        vector<node> set_tmp;
-        for (int64 i = 1; i <= stack_kS_top; i++) set_tmp.emplace_back(stack_kS[i]);
-        V_n.emplace_back(set_tmp);
-        return;
+double MC_simulation(Graph &graph, vector<node> &S, double threshold = -1, double *upper = nullptr) {
+    double cur = wall_clock();
+    std::atomic<int64> meet_time(0); //Too large for int!
+    double res = run_estimator([&](int32 tid, int64 rounds, int64 &sum, int64 &sumsq) {
+        MC_state &st = thread_MC_state();
+        st.resize(graph.n);
+        st.meet_time = 0;
+        for (int64 i = 0; i < rounds; i++) {
+            int64 x = MC_round(graph, S, st);
+            sum += x, sumsq += x * x;
+        }
+        meet_time += st.meet_time;
+        profile_count(COUNTER_EDGES, st.edges), st.edges = 0;
+    }, 64, threshold, upper);
+    if (verbose_flag) {
+        double t = time_by(cur);
+        cout << "\t\tresult=" << res << " time=" << t << " meet time=" << meet_time << " rounds=" << MC_last_rounds
+             << " cascades/s=" << MC_last_rounds / max(t, 1e-9) << endl;
     }
-    int u = *it;
-    if (is_new) {
-        if (it == S.begin())
-            for (auto w : S) node_selected[w] = 2;
-        neighbour_selected[u] = 0;
-        for (int64 i = 0; i < graph.g[u].size(); i++) {
-            node v = graph.g[u][i].v;
-            if (node_selected[v] == 1) neighbour_selected[u]++;
+    return res;
+}
+
+/*!
+ * @brief CELF++ lookahead : estimate sigma(S) and sigma(S + {best}) in the same MC_iteration_rounds worlds.
+ *
+ * Each world is traversed from S, then from best on top of it, so both values come from one pass.
+ * @param graph : the graph that define propagation models(IC or IC-M)
+ * @param S : the seed set
+ * @param best : the extra seed, -1 for none
+ * @param with_best : returns the estimated value of sigma(S + {best})
+ * @return the estimated value of sigma(S)
+ */
+double MC_lookahead(Graph &graph, vector<node> &S, node best, double &with_best) {
+    phase_timer timer(PHASE_MC_SIMULATION);
+    double cur = wall_clock();
+    ThreadPool &pool = thread_pool();
+    int64 batches = max((int64) 1, min(MC_iteration_rounds / 64, (int64) pool.size() * 4));
+    vector<int64> s(batches, 0), s2(batches, 0);
+    vector<node> extra(1, best);
+    pool.parallel_for(batches, [&](int32 tid, int64 b) {
+        MC_state &st = thread_MC_state();
+        for (int64 i = MC_iteration_rounds * b / batches; i < MC_iteration_rounds * (b + 1) / batches; i++) {
+            uint64_t world = ((uint64_t) st.engine() << 32) ^ st.engine();
+            int64 x = MC_world_traverse(graph, world, S, st);
+            s[b] += x;
+            s2[b] += best == -1 ? x : x + MC_world_traverse(graph, world, extra, st);
+            for (node v : st.reached) st.time[v] = -1;
+            st.reached.clear();
         }
+        profile_count(COUNTER_EDGES, st.edges), st.edges = 0;
+    });
+    double res = 0;
+    with_best = 0;
+    for (int64 b = 0; b < batches; b++) res += s[b], with_best += s2[b];
+    res /= MC_iteration_rounds, with_best /= MC_iteration_rounds;
+    MC_last_rounds = MC_iteration_rounds;
+    MC_rounds_used += MC_iteration_rounds;
+    profile_count(COUNTER_MC_ROUNDS, MC_iteration_rounds);
+    MC_simulation_calls++;
+    if (verbose_flag) {
+        cout << "\t\tresult=" << res << " with best=" << with_best << " time=" << time_by(cur) << endl;
     }
-    if (k_now == k0 || neighbour_selected[u] == graph.g[u].size()) {
-        select_neighbours(graph, S, V_n, k0, 0, 0, ++it, true);
-    } else {
-        for (int64 i = i_now; i < graph.g[u].size(); i++) {
-            int v = graph.g[u][i].v;
-            if (!node_selected[v]) {
-                node_selected[v] = 1;
-                k_now++;
-                neighbour_selected[u]++;
-                stack_kS[++stack_kS_top] = v;
-                select_neighbours(graph, S, V_n, k0, k_now, i + 1, it, false);
-                node_selected[v] = 0;
-                k_now--;
-                neighbour_selected[u]--;
-                --stack_kS_top;
-            }
+    return res;
+}
+
+/*!
+ * @brief Bit-parallel MC simulation to evaluate the influence spread with MC_iteration_rounds cascades.
+ *
+ * Passes of 64 cascades run on the thread pool, each thread with its own masks and random stream.
+ * @param graph : the graph that define propagation models(IC or IC-M)
+ * @param S : the seed set
+ * @param threshold : stop as soon as the upper confidence bound is below it, -1 for none
+ * @param upper : if not null, returns the upper confidence bound
+ * @return the estimated value of influence spread
+ */
+double BP_simulation(Graph &graph, vector<node> &S, double threshold = -1, double *upper = nullptr) {
+    double cur = wall_clock();
+    double res = run_estimator([&](int32 tid, int64 rounds, int64 &sum, int64 &sumsq) {
+        for (int64 i = 0; i < rounds; i += 64) {
+            int64 lanes = min((int64) 64, rounds - i), sq = 0;
+            uint64_t worlds = lanes == 64 ? ~0ull : (1ull << lanes) - 1;
+            sum += BP_pass(graph, S, worlds, thread_BP_state(), &sq);
+            sumsq += sq;
+        }
+    }, 64, threshold, upper);
+    if (verbose_flag) {
+        double t = time_by(cur);
+        cout << "\t\tresult=" << res << " time=" << t << " rounds=" << MC_last_rounds
+             << " cascades/s=" << MC_last_rounds / max(t, 1e-9) << endl;
+    }
+    return res;
+}
+
+/*!
+ * @brief evaluate the influence spread with the estimator chosen by the spread_estimator of the current context.
+ * @param graph : the graph
+ * @param S : the seed set
+ * @param threshold : stop as soon as the upper confidence bound is below it, -1 for none
+ * @param upper : if not null, returns the upper confidence bound
+ * @return the estimated value of influence spread
+ */
+double estimate_spread(Graph &graph, vector<node> &S, double threshold = -1, double *upper = nullptr) {
+    switch (ctx().spread_estimator) {
+        case BP_ESTIMATOR:
+            return BP_simulation(graph, S, threshold, upper);
+        case SNAPSHOT_ESTIMATOR: {
+            auto snapshots = snapshots_of(graph);
+            std::lock_guard<std::mutex> lock(snapshots->use);
+            double res = snapshots->spread(S);
+            if (upper) *upper = res;
+            return res;
+        }
+        case SKETCH_ESTIMATOR: {
+            double res = sketches_of(graph)->spread(S);
+            if (upper) *upper = res;
+            return res;
         }
+        default:
+            return MC_simulation(graph, S, threshold, upper);
     }
-    if (is_new && it == S.begin()) for (int w : S) node_selected[w] = 0;
 }
 
 /*!
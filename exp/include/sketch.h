@@ -0,0 +1,228 @@
+// Combined bottom-k reachability sketch (SKIM) estimator
+
+#ifndef EXP_SKETCH_H
+#define EXP_SKETCH_H
+
+#include "bitsim.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <memory>
+
+/*!
+ * @brief An influence estimator from combined reachability sketches over L live-edge graphs.
+ *
+ * Every pair (v, i) of a node and a live-edge graph gets a random rank, and the sketch of u keeps the k smallest
+ * ranks of the pairs (v, i) such that u reaches v in the i-th live-edge graph (within the deadline in IC-M).
+ * The sketch of S is the k smallest ranks of the union of the sketches of its nodes, so sigma(S) is
+ * (k - 1) / (k-th smallest rank) / L, or exact if fewer than k ranks are left.
+ *
+ * The sketches are built by visiting the pairs in increasing rank order with a reverse traversal from v, which
+ * adds the rank to every node that reaches v. In IC a node whose sketch is full is not expanded, because every
+ * node that reaches it has a full sketch too. This does not hold with a deadline, so in IC-M nothing is pruned.
+ * The live-edge graphs are dropped after the sketches are built. All queries are read-only except add_seed.
+ */
+class SketchOracle {
+public:
+    /*!
+     * @brief Sample L live-edge graphs of the graph with its current diffusion model and build the sketches.
+     * @param graph : the graph
+     * @param L : number of live-edge graphs
+     * @param K : size of the sketches
+     */
+    void build(Graph &graph, int64 L, int64 K) {
+        double cur = wall_clock();
+        if ((double) graph.n * L >= 4294967295.0) {
+            std::cerr << "(get error) sketch estimator supports n * instances < 2^32" << std::endl;
+            std::exit(-1);
+        }
+        owner = &graph, n = graph.n, m = graph.m, version = graph.version, model = graph.diff_model;
+        horizon = graph.diff_model == IC_M ? graph.deadline : 0;
+        this->L = L, k = K, N = n * L;
+        //reversed live-edge graphs : the live in-edges of v are source[offset[v] .. offset[v+1])
+        vector<vector<uint32_t>> offset(L), source(L);
+        vector<vector<uint8_t>> delay(L);
+        thread_pool().parallel_for(L, [&](int32 tid, int64 i) {
+            rng64 rng(((uint64_t) rd__() << 32) ^ rd__() ^ (uint64_t) i);
+            auto uniform = [&]() { return (rng() >> 11) * (1.0 / 9007199254740992.0); };
+            //sample from the out-edges, which carry the probabilities of every model, and transpose
+            vector<uint32_t> from, to;
+            vector<uint8_t> D;
+            offset[i].assign(n + 1, 0);
+            for (node u = 0; u < n; u++) {
+                for (auto &edge : graph.g[u]) {
+                    if (uniform() >= edge.p) continue;
+                    uint8_t d = 0;
+                    if (model == IC_M) {
+                        //inverse transform of Geometric(m) + 1
+                        double x = edge.m >= 1.0 ? 1 : 1 + floor(log(1.0 - uniform()) / log(1.0 - edge.m));
+                        if (x > horizon) continue;
+                        d = (uint8_t) x;
+                    }
+                    from.emplace_back((uint32_t) u), to.emplace_back((uint32_t) edge.v), D.emplace_back(d);
+                    offset[i][edge.v + 1]++;
+                }
+            }
+            for (node v = 0; v < n; v++) offset[i][v + 1] += offset[i][v];
+            source[i].resize(from.size()), delay[i].resize(from.size());
+            vector<uint32_t> fill(offset[i].begin(), offset[i].end() - 1);
+            for (int64 e = 0; e < from.size(); e++) {
+                uint32_t j = fill[to[e]]++;
+                source[i][j] = from[e], delay[i][j] = D[e];
+            }
+        });
+        //ranks are the positions in a random order of all pairs (v, i), stored as i * n + v
+        vector<uint32_t> order(N);
+        for (int64 j = 0; j < N; j++) order[j] = (uint32_t) j;
+        std::mt19937 engine(rd__());
+        shuffle(order.begin(), order.end(), engine);
+        sketch.assign(n * k, 0);
+        size.assign(n, 0);
+        vector<int64> dist(n, -1);
+        vector<node> visited;
+        vector<vector<node>> bucket(horizon + 1);
+        int64 full = 0, steps = 0;
+        for (uint32_t rank = 0; rank < N && full < n; rank++) {
+            node v = order[rank] % n;
+            int64 i = order[rank] / n;
+            if (model != IC_M && size[v] == k) continue;
+            auto visit = [&](node u, int64 d) {
+                if (dist[u] != -1 && dist[u] <= d) return false;
+                if (dist[u] == -1) {
+                    visited.emplace_back(u);
+                    if (size[u] < k) {
+                        sketch[u * k + size[u]++] = rank;
+                        if (size[u] == k) full++;
+                    } else if (model != IC_M) {
+                        dist[u] = d;
+                        return false;
+                    }
+                }
+                dist[u] = d;
+                return true;
+            };
+            visit(v, 0);
+            bucket[0].emplace_back(v);
+            for (int64 d = 0; d <= horizon; d++) {
+                auto &B = bucket[d];
+                for (int64 j = 0; j < B.size(); j++) {
+                    node w = B[j];
+                    if (dist[w] != d) continue;
+                    for (uint32_t e = offset[i][w]; e < offset[i][w + 1]; e++) {
+                        steps++;
+                        int64 nd = d + delay[i][e];
+                        if (nd <= horizon && visit(source[i][e], nd)) bucket[nd].emplace_back(source[i][e]);
+                    }
+                }
+                B.clear();
+            }
+            for (node u : visited) dist[u] = -1;
+            visited.clear();
+        }
+        merged.clear(), current = 0;
+        if (verbose_flag) {
+            printf("\tsketches built. L = %ld, k = %ld, full sketches = %ld / %ld, edges scanned = %ld, time = %.3f\n",
+                   (long) L, (long) k, (long) full, (long) n, (long) steps, time_by(cur));
+        }
+    }
+
+    /*!
+     * @brief Check if the sketches are built from the graph with its current diffusion model.
+     */
+    bool built_for(Graph &graph, int64 L, int64 K) const {
+        return owner == &graph && n == graph.n && m == graph.m && version == graph.version &&
+               model == graph.diff_model && horizon == (graph.diff_model == IC_M ? graph.deadline : 0) &&
+               this->L == L && k == K;
+    }
+
+    /*!
+     * @brief Clear the seed set.
+     */
+    void reset() {
+        merged.clear(), current = 0;
+    }
+
+    /*!
+     * @brief The marginal gain of v on the current seed set.
+     */
+    double marginal_gain(node v) const {
+        vector<uint32_t> res;
+        merge(merged, v, res);
+        return estimate(res) - current;
+    }
+
+    /*!
+     * @brief Add v to the current seed set.
+     * @return the marginal gain of v
+     */
+    double add_seed(node v) {
+        vector<uint32_t> res;
+        merge(merged, v, res);
+        double gain = estimate(res) - current;
+        merged.swap(res);
+        current += gain;
+        return gain;
+    }
+
+    /*!
+     * @brief The influence spread of S. The current seed set is not changed.
+     */
+    double spread(const vector<node> &S) const {
+        vector<uint32_t> cur, res;
+        for (node v : S) merge(cur, v, res), cur.swap(res);
+        return estimate(cur);
+    }
+
+    /// the influence spread of the current seed set
+    double current = 0;
+    /// held by the solver that keeps its seed set in the oracle
+    std::mutex use;
+
+private:
+    vector<uint32_t> sketch, merged;
+    vector<int64> size;
+    const Graph *owner = nullptr;
+    node n = 0;
+    int64 m = 0, version = 0, horizon = 0, L = 0, k = 0, N = 0;
+    model_type model = NONE;
+
+    /// res = the k smallest distinct ranks of a and the sketch of v
+    void merge(const vector<uint32_t> &a, node v, vector<uint32_t> &res) const {
+        const uint32_t *b = sketch.data() + v * k;
+        int64 i = 0, j = 0, nb = size[v];
+        res.clear();
+        while (res.size() < k && (i < a.size() || j < nb)) {
+            uint32_t x = (j == nb || (i < a.size() && a[i] < b[j])) ? a[i++] : b[j++];
+            if (res.empty() || res.back() != x) res.emplace_back(x);
+        }
+    }
+
+    double estimate(const vector<uint32_t> &s) const {
+        if (s.size() < k) return (double) s.size() / L;
+        //the k-th smallest of the ranks, which are uniform in (0, 1)
+        double tau = (s[k - 1] + 1.0) / (N + 1.0);
+        return (k - 1) / tau / L;
+    }
+};
+
+///number of live-edge graphs and size of the sketches of the sketch estimator
+int64 sketch_instances = 64, sketch_size = 64;
+std::shared_ptr<SketchOracle> sketch_oracle;
+
+/*!
+ * @brief The sketch estimator of the graph, built at the first use and shared by all solver contexts.
+ *
+ * Stale sketches are replaced by freshly built ones rather than rebuilt in place, so the readers that still hold
+ * the old sketches are not disturbed.
+ */
+std::shared_ptr<SketchOracle> sketches_of(Graph &graph) {
+    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!sketch_oracle || !sketch_oracle->built_for(graph, sketch_instances, sketch_size)) {
+        auto fresh = std::make_shared<SketchOracle>();
+        fresh->build(graph, sketch_instances, sketch_size);
+        sketch_oracle = fresh;
+    }
+    return sketch_oracle;
+}
+
+#endif //EXP_SKETCH_H
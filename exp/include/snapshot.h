@@ -0,0 +1,215 @@
+// Live-edge snapshot (StaticGreedy) estimator
+
+#ifndef EXP_SNAPSHOT_H
+#define EXP_SNAPSHOT_H
+
+#include "bitsim.h"
+#include "threadpool.h"
+#include <memory>
+
+/*!
+ * @brief An influence estimator over R live-edge graphs that are sampled once.
+ *
+ * In IC an edge survives with probability p. In IC-M it survives with probability p and gets a meeting delay
+ * D ~ Geometric(m) + 1, and it is kept only if D <= deadline. For the current seed set every snapshot keeps
+ * the earliest activation time dist[v] of each node (0 for all reached nodes in IC, 255 for unreached),
+ * so the marginal gain of a node only traverses what it newly reaches or reaches earlier.
+ */
+class SnapshotOracle {
+public:
+    /*!
+     * @brief Sample R snapshots of the graph with its current diffusion model.
+     * @param graph : the graph
+     * @param R : number of snapshots
+     */
+    void build(Graph &graph, int64 R) {
+        double cur = wall_clock();
+        if (graph.diff_model == IC_M && graph.deadline >= UNREACHED) {
+            std::cerr << "(get error) snapshot estimator supports deadline < " << (int) UNREACHED << std::endl;
+            std::exit(-1);
+        }
+        owner = &graph, n = graph.n, m = graph.m, version = graph.version, model = graph.diff_model;
+        horizon = graph.diff_model == IC_M ? graph.deadline : 0;
+        snaps.clear();
+        snaps.resize(R);
+        thread_pool().parallel_for(R, [&](int32 tid, int64 r) {
+            rng64 rng(((uint64_t) rd__() << 32) ^ rd__() ^ (uint64_t) r);
+            auto uniform = [&]() { return (rng() >> 11) * (1.0 / 9007199254740992.0); };
+            Snapshot &s = snaps[r];
+            s.offset.assign(n + 1, 0);
+            for (node u = 0; u < n; u++) {
+                for (auto &edge : graph.g[u]) {
+                    if (uniform() >= edge.p) continue;
+                    uint8_t delay = 0;
+                    if (model == IC_M) {
+                        //inverse transform of Geometric(m) + 1
+                        double D = edge.m >= 1.0 ? 1 : 1 + floor(log(1.0 - uniform()) / log(1.0 - edge.m));
+                        if (D > horizon) continue;
+                        delay = (uint8_t) D;
+                    }
+                    s.target.emplace_back((uint32_t) edge.v);
+                    s.delay.emplace_back(delay);
+                }
+                s.offset[u + 1] = s.target.size();
+            }
+            s.target.shrink_to_fit(), s.delay.shrink_to_fit();
+            s.dist.assign(n, UNREACHED);
+        });
+        current = 0;
+        if (verbose_flag) {
+            int64 live = 0;
+            for (auto &s : snaps) live += s.target.size();
+            printf("\tsnapshots built. R = %ld, average live edges = %.1f, time = %.3f\n", (long) R,
+                   (double) live / R, time_by(cur));
+        }
+    }
+
+    /*!
+     * @brief Check if the snapshots are sampled from the graph with its current diffusion model.
+     */
+    bool built_for(Graph &graph, int64 R) const {
+        return owner == &graph && n == graph.n && m == graph.m && version == graph.version &&
+               model == graph.diff_model && horizon == (graph.diff_model == IC_M ? graph.deadline : 0) &&
+               snaps.size() == R;
+    }
+
+    /*!
+     * @brief Clear the seed set.
+     */
+    void reset() {
+        thread_pool().parallel_for(snaps.size(), [&](int32 tid, int64 r) {
+            for (node v : snaps[r].touched) snaps[r].dist[v] = UNREACHED;
+            snaps[r].touched.clear();
+        });
+        current = 0;
+    }
+
+    /*!
+     * @brief The marginal gain of v on the current seed set, averaged over all snapshots.
+     */
+    double marginal_gain(node v) {
+        return traverse_all(v, false);
+    }
+
+    /*!
+     * @brief Add v to the current seed set.
+     * @return the marginal gain of v
+     */
+    double add_seed(node v) {
+        double gain = traverse_all(v, true);
+        current += gain;
+        return gain;
+    }
+
+    /*!
+     * @brief The influence spread of S. The current seed set is replaced by S.
+     */
+    double spread(vector<node> &S) {
+        reset();
+        for (node v : S) add_seed(v);
+        return current;
+    }
+
+    /// the influence spread of the current seed set
+    double current = 0;
+    /// held by the solver that keeps its seed set in the oracle
+    std::mutex use;
+
+private:
+    enum : uint8_t { UNREACHED = 255 };
+
+    /// live edges of u : target[offset[u] .. offset[u+1]) with their delays
+    struct Snapshot {
+        vector<uint32_t> offset, target;
+        vector<uint8_t> delay, dist;
+        vector<node> touched;
+    };
+
+    /// per-thread temporary activation times, all UNREACHED between two traversals
+    struct Temp {
+        vector<uint8_t> tdist;
+        vector<node> visited;
+        vector<vector<node>> bucket;
+    };
+
+    vector<Snapshot> snaps;
+    vector<Temp> temps;
+    const Graph *owner = nullptr;
+    node n = 0;
+    int64 m = 0, version = 0, horizon = 0;
+    model_type model = NONE;
+
+    double traverse_all(node v, bool commit) {
+        if (temps.size() < thread_pool().size()) temps.resize(thread_pool().size());
+        vector<int64> gain(snaps.size(), 0);
+        thread_pool().parallel_for(snaps.size(), [&](int32 tid, int64 r) {
+            gain[r] = traverse(snaps[r], v, temps[tid], commit);
+        });
+        int64 total = 0;
+        for (int64 x : gain) total += x;
+        return (double) total / snaps.size();
+    }
+
+    /*!
+     * @brief Earliest-arrival traversal from v that only goes where v arrives earlier than the seed set.
+     * @return the number of nodes newly reached
+     */
+    int64 traverse(Snapshot &s, node v, Temp &t, bool commit) {
+        if (s.dist[v] == 0) return 0;
+        if (t.tdist.size() < n) t.tdist.assign(n, UNREACHED);
+        if (t.bucket.size() < horizon + 1) t.bucket.resize(horizon + 1);
+        int64 newly = 0;
+        auto relax = [&](node w, int64 d) {
+            if (d >= min(s.dist[w], t.tdist[w])) return;
+            if (t.tdist[w] == UNREACHED) {
+                t.visited.emplace_back(w);
+                if (s.dist[w] == UNREACHED) newly++;
+            }
+            t.tdist[w] = (uint8_t) d;
+            t.bucket[d].emplace_back(w);
+        };
+        relax(v, 0);
+        for (int64 d = 0; d <= horizon; d++) {
+            auto &B = t.bucket[d];
+            for (int64 i = 0; i < B.size(); i++) {
+                node u = B[i];
+                if (t.tdist[u] != d) continue;
+                for (uint32_t j = s.offset[u]; j < s.offset[u + 1]; j++)
+                    if (d + s.delay[j] <= horizon) relax(s.target[j], d + s.delay[j]);
+            }
+            B.clear();
+        }
+        for (node w : t.visited) {
+            if (commit) {
+                if (s.dist[w] == UNREACHED) s.touched.emplace_back(w);
+                s.dist[w] = t.tdist[w];
+            }
+            t.tdist[w] = UNREACHED;
+        }
+        t.visited.clear();
+        return newly;
+    }
+};
+
+///number of snapshots of the snapshot estimator
+int64 snapshot_rounds = 100;
+std::shared_ptr<SnapshotOracle> snapshot_oracle;
+
+/*!
+ * @brief The snapshot estimator of the graph, sampled at the first use and shared by all solver contexts.
+ *
+ * A stale estimator is not rebuilt in place : a fresh one is sampled and swapped in, so a query that still holds
+ * the old one keeps reading consistent snapshots.
+ */
+std::shared_ptr<SnapshotOracle> snapshots_of(Graph &graph) {
+    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!snapshot_oracle || !snapshot_oracle->built_for(graph, snapshot_rounds)) {
+        auto fresh = std::make_shared<SnapshotOracle>();
+        fresh->build(graph, snapshot_rounds);
+        snapshot_oracle = fresh;
+    }
+    return snapshot_oracle;
+}
+
+#endif //EXP_SNAPSHOT_H
@@ -0,0 +1,146 @@
+// A fixed-size thread pool for parallel loops
+
+#ifndef EXP_THREADPOOL_H
+#define EXP_THREADPOOL_H
+
+#include "profile.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class Context;
+
+/*!
+ * @brief The solver context of the calling thread, nullptr for the default context, see context.h.
+ */
+Context *&current_context() {
+    static thread_local Context *context = nullptr;
+    return context;
+}
+
+/*!
+ * @brief A pool of worker threads that runs parallel loops.
+ *
+ * The calling thread takes part in every loop as thread 0, and the workers are 1 .. size()-1.
+ * A loop started from inside a loop body runs serially on the calling thread with its own thread id, or with
+ * thread id 0 if the outer loop belongs to another pool, so per-thread states indexed by the thread id of a pool
+ * are never shared as long as a pool is only used by one outside thread at a time. The workers run the loop body
+ * in the solver context of the calling thread.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(int32 threads) : threads(max(1, threads)) {
+        for (int32 t = 1; t < this->threads; t++) workers.emplace_back(&ThreadPool::worker, this, t);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            quit = true;
+        }
+        cv_job.notify_all();
+        for (auto &t : workers) t.join();
+    }
+
+    int32 size() const { return threads; }
+
+    /// id of the calling thread in the pool
+    static int32 &thread_id() {
+        static thread_local int32 tid = 0;
+        return tid;
+    }
+
+    /*!
+     * @brief Run f(tid, i) for every i in [0, tasks) and wait for all of them.
+     * @param tasks : number of tasks
+     * @param f : the loop body
+     */
+    void parallel_for(int64 tasks, const std::function<void(int32, int64)> &f) {
+        if (loop_pool() != nullptr) {
+            int32 tid = loop_pool() == this ? thread_id() : 0;
+            for (int64 i = 0; i < tasks; i++) f(tid, i);
+            return;
+        }
+        //loops started by different outside threads run one after another
+        std::lock_guard<std::mutex> outer(loop_mtx);
+        if (threads == 1 || tasks <= 1) {
+            loop_pool() = this;
+            for (int64 i = 0; i < tasks; i++) f(0, i);
+            loop_pool() = nullptr;
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        body = &f;
+        context = current_context();
+        phase = current_phase();
+        num_tasks = tasks;
+        next_task = 0;
+        running = threads;
+        generation++;
+        lock.unlock();
+        cv_job.notify_all();
+        run(0);
+        lock.lock();
+        cv_done.wait(lock, [this]() { return running == 0; });
+        body = nullptr;
+    }
+
+private:
+    int32 threads;
+    vector<std::thread> workers;
+    std::mutex mtx, loop_mtx;
+    std::condition_variable cv_job, cv_done;
+    const std::function<void(int32, int64)> *body = nullptr;
+    Context *context = nullptr;
+    ///the phase of the calling thread, which the workers count for
+    int32 phase = -1;
+    std::atomic<int64> next_task{0};
+    int64 num_tasks = 0, generation = 0;
+    int32 running = 0;
+    bool quit = false;
+
+    /// the pool whose loop the calling thread is running, nullptr outside of loops
+    static const ThreadPool *&loop_pool() {
+        static thread_local const ThreadPool *pool = nullptr;
+        return pool;
+    }
+
+    void run(int32 tid) {
+        loop_pool() = this;
+        Context *own = current_context();
+        int32 own_phase = current_phase();
+        current_context() = context, current_phase() = phase;
+        {
+            //the calling thread is counted by its own phase_timer
+            perf_scope counters(tid == 0 ? -1 : phase);
+            for (int64 i = next_task++; i < num_tasks; i = next_task++) (*body)(tid, i);
+        }
+        current_context() = own, current_phase() = own_phase;
+        loop_pool() = nullptr;
+        std::lock_guard<std::mutex> lock(mtx);
+        if (--running == 0) cv_done.notify_all();
+    }
+
+    void worker(int32 tid) {
+        thread_id() = tid;
+        int64 seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_job.wait(lock, [&]() { return quit || generation != seen; });
+                if (quit) return;
+                seen = generation;
+            }
+            run(tid);
+        }
+    }
+};
+
+/*!
+ * @brief The pool of the parallel loops of the current context, see context.h.
+ */
+ThreadPool &thread_pool();
+
+#endif //EXP_THREADPOOL_H
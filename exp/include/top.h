@@ -8,8 +8,70 @@
 #include "IMs.h"
 #include "argparse.h"
 #include "IMM.h"
+#include "OPIM.h"
+#include "rreval.h"
 
 string graphFilePath;
+///output file and estimator of --precompute-mg0
+string MG0_output_path, MG0_estimator;
+///socket path of --serve, "stdio" for stdin/stdout, and the file descriptor of the replies in the stdin/stdout mode
+string serve_path;
+int serve_reply_fd = -1;
+///number of requests of --serve answered concurrently, and the maximum number of open connections
+int32 serve_workers = 4;
+int64 serve_connections = 256;
+///query file and output file of --batch, and number of RI sets of its selection pool
+string batch_path, batch_output_path;
+int64 batch_RR_sets = 200000;
+///backend of the seed quality evaluation in Run_simulation : rr, fi, mc or sketch
+string evaluator = "rr";
+///number of concurrent tasks of Run_simulation, and the resident memory in MB above which no task is started, 0 for none
+int32 sweep_jobs = 1;
+int64 sweep_memory_limit = 0;
+///checkpoint directory of Run_simulation, empty for none
+string checkpoint_dir;
+///Run_simulation only runs the tasks with id % shard_count == shard_id, the others are read from the checkpoint
+int32 shard_id = 0, shard_count = 1;
+
+#define SOLVER_NUM 11
+string solver_name[SOLVER_NUM] = {"ENUMERATION", "DEGREE", "PAGERANK", "CELF", "DEGREE_ADVANCED", "PAGERANK_ADVANCED",
+                                  "CELF_ADVANCED", "IMM_NORMAL", "IMM_ADVANCED", "OPIM_NORMAL", "LOCAL_PPR"};
+#define ESTIMATOR_NUM 4
+string estimator_name[ESTIMATOR_NUM] = {"mc", "bp", "snapshot", "sketch"};
+///spread estimator used by each solver
+estimator_type solver_estimator[SOLVER_NUM];
+
+/*!
+ * @brief Set the spread estimators of solvers.
+ * @param spec : comma-separated list. "name" sets all solvers, "SOLVER=name" sets a single solver,
+ * e.g. "mc,CELF_ADVANCED=snapshot". Later entries override earlier ones.
+ */
+void set_estimators(const string &spec) {
+    stringstream ss(spec);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        auto eq = item.find('=');
+        string name = eq == string::npos ? item : item.substr(eq + 1);
+        auto est = find(estimator_name, estimator_name + ESTIMATOR_NUM, name) - estimator_name;
+        if (est == ESTIMATOR_NUM) {
+            std::cerr << "(get error) unknown estimator: " << name << std::endl;
+            std::exit(-1);
+        }
+        if (eq == string::npos) {
+            for (auto &e : solver_estimator) e = (estimator_type) est;
+            continue;
+        }
+        string solver = item.substr(0, eq);
+        transform(solver.begin(), solver.end(), solver.begin(), ::toupper);
+        auto id = find(solver_name, solver_name + SOLVER_NUM, solver) - solver_name;
+        if (id == SOLVER_NUM) {
+            std::cerr << "(get error) unknown solver: " << item.substr(0, eq) << std::endl;
+            std::exit(-1);
+        }
+        solver_estimator[id] = (estimator_type) est;
+    }
+}
 
 void init_commandLine(int argc, char const *argv[]) {
     auto args = util::argparser("The experiment of BIM.");
@@ -19,32 +81,148 @@ void init_commandLine(int argc, char const *argv[]) {
             .add_option("-v", "--verbose", "output verbose message or not")
             .add_option<std::string>("-l", "--local", "use local value as single spread or not", "")
             .add_option<int64>("-r", "--rounds", "number of MC simulation iterations per time, default is 10000", 10000)
+            .add_option<int64>("-t", "--threads", "number of worker threads, default is the number of cores", 0)
+            .add_option("-p", "--pipeline", "run IMM sampling and node selection concurrently or not")
+            .add_option<double>("-a", "--adaptive", "relative error target of adaptive MC rounds, default is 0 (fixed rounds)", 0)
+            .add_option<std::string>("-e", "--estimator", "spread estimator of CELF and enumeration: mc, bp, snapshot or sketch, optionally per solver as SOLVER=name, default is mc", "mc")
+            .add_option<int64>("", "--snapshots", "number of live-edge snapshots of the snapshot estimator, default is 100", 100)
+            .add_option<int64>("", "--sketch-instances", "number of live-edge graphs of the sketch estimator, default is 64", 64)
+            .add_option<int64>("", "--sketch-k", "size of the reachability sketches of the sketch estimator, default is 64", 64)
+            .add_option<std::string>("", "--evaluator", "backend of the seed quality evaluation: rr, fi, mc or sketch, default is rr", "rr")
+            .add_option<int64>("", "--eval-sets", "number of RI sets of the rr evaluator, default is 1000000", 1000000)
+            .add_option<std::string>("", "--serve", "answer queries on this UNIX socket, or on stdin/stdout if it is stdio", "")
+            .add_option<int64>("", "--serve-workers", "number of requests of --serve answered concurrently, default is 4", 4)
+            .add_option<int64>("", "--serve-connections", "maximum number of open connections of --serve, default is 256", 256)
+            .add_option<std::string>("", "--batch", "solve the queries of this file and exit, one JSON query per line", "")
+            .add_option<std::string>("", "--batch-output", "output file of --batch, default is batch.jsonl", "batch.jsonl")
+            .add_option<int64>("", "--batch-sets", "number of RI sets of the selection pool of --batch, default is 200000", 200000)
+            .add_option<std::string>("", "--precompute-mg0", "compute the single-node spreads of all nodes into this binary local file and exit", "")
+            .add_option<std::string>("", "--mg0-estimator", "estimator of --precompute-mg0: mc, bp or rr, default is mc", "mc")
+            .add_option<double>("", "--ppr-rmax", "residual threshold of the LOCAL_PPR solver, default is 1e-6", 1e-6)
+            .add_option<int64>("-j", "--jobs", "number of experiment tasks run concurrently, default is 1", 1)
+            .add_option<int64>("", "--memory-limit", "no experiment task is started while the resident memory exceeds this many MB, default is 0 (none)", 0)
+            .add_option<std::string>("", "--checkpoint", "save the finished experiment tasks in this directory of the output folder and skip them when run again", "")
+            .add_option<std::string>("", "--shard", "only run the experiment tasks of shard i of n, given as i/n, default is 0/1", "0/1")
+            .add_option<std::string>("", "--profile", "append a JSON record of phase times and counters of every solver call to this file of the output folder", "")
+            .add_option("", "--perf", "attach hardware counters to the profiled phases and print IPC and misses per edge at exit")
+            .add_option<double>("-b", "--budget", "wall-clock budget in seconds of each IMM call, default is 0 (unlimited)", 0)
             .parse(argc, argv);
+    serve_path = args.get_option_string("--serve");
+    serve_workers = (int32) max((int64) 1, args.get_option_int64("--serve-workers"));
+    serve_connections = max((int64) 1, args.get_option_int64("--serve-connections"));
+    if (serve_path == "stdio") {
+        //stdout only carries the replies of the server, and the log goes to stderr
+        fflush(stdout);
+        serve_reply_fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+    if (!args.get_option_string("--profile").empty()) {
+        string path = "../output/" + args.get_option_string("--profile");
+        profile_out.open(path, ios::out | ios::app);
+        if (!profile_out.is_open()) {
+            std::cerr << "(get error) cannot write profile: " << path << std::endl;
+            std::exit(-1);
+        }
+        profile_flag = 1;
+        cout << "profile records set to " << path << endl;
+    }
+    if (args.has_option("--perf")) {
+        //the counters are kept per phase even without a profile file, for the summary at exit
+        perf_flag = true, profile_flag = 1;
+        atexit(print_perf_summary);
+        cout << "hardware counters set\n";
+    }
     graphFilePath = "../data/" + args.get_argument_string("input");
+    pagerank_cache_prefix = graphFilePath;
     if (args.has_option("--verbose")) {
         verbose_flag = 1;
         cout << "verbose flag set to 1\n";
     }
     if (!args.get_option_string("--local").empty()) {
         local_mg = 1;
-        string MGPath = "../data/" + args.get_option_string("--local");
-        cout << "local spread flag set to 1, file path = " << MGPath << endl;
-        ifstream inFile(MGPath, ios::in);
-        if (!inFile.is_open()) {
+        MG0_path = "../data/" + args.get_option_string("--local");
+        cout << "local spread flag set to 1, file path = " << MG0_path << endl;
+        if (access(MG0_path.c_str(), R_OK) != 0) {
             std::cerr << "(get error) local file not found: " << args.get_option_string("--local") << std::endl;
             std::exit(-1);
         }
-        int64 cnt = 0;
-        while (inFile.good()) inFile >> MG0[cnt++];
-        inFile.close();
+    }
+    if (!args.get_option_string("--batch").empty()) {
+        batch_path = "../data/" + args.get_option_string("--batch");
+        batch_output_path = "../output/" + args.get_option_string("--batch-output");
+        batch_RR_sets = max((int64) 1, args.get_option_int64("--batch-sets"));
+        cout << "batch mode, queries = " << batch_path << ", output = " << batch_output_path << endl;
+    }
+    if (!args.get_option_string("--precompute-mg0").empty()) {
+        MG0_output_path = "../data/" + args.get_option_string("--precompute-mg0");
+        MG0_estimator = args.get_option_string("--mg0-estimator");
+        if (MG0_estimator != "mc" && MG0_estimator != "bp" && MG0_estimator != "rr") {
+            std::cerr << "(get error) unknown MG0 estimator: " << MG0_estimator << std::endl;
+            std::exit(-1);
+        }
+        cout << "precompute MG0 to " << MG0_output_path << " with estimator " << MG0_estimator << endl;
     }
     MC_iteration_rounds = args.get_option_int64("--rounds");
     cout << "MC_iteration_rounds set to " << MC_iteration_rounds << endl;
+    MC_rel_error = args.get_option_double("--adaptive");
+    if (MC_rel_error > 0) cout << "adaptive MC rounds, relative error set to " << MC_rel_error << endl;
+    num_threads = (int32) args.get_option_int64("--threads");
+    if (num_threads <= 0) num_threads = max(1, (int32) std::thread::hardware_concurrency());
+    cout << "num_threads set to " << num_threads << endl;
+    if (args.has_option("--pipeline")) {
+        pipeline_flag = 1;
+        cout << "pipeline flag set to 1\n";
+    }
+    set_estimators(args.get_option_string("--estimator"));
+    cout << "spread estimator set to " << args.get_option_string("--estimator") << endl;
+    snapshot_rounds = max((int64) 1, args.get_option_int64("--snapshots"));
+    if (args.get_option_string("--estimator").find("snapshot") != string::npos)
+        cout << "number of snapshots set to " << snapshot_rounds << endl;
+    ppr_rmax = args.get_option_double("--ppr-rmax");
+    sketch_instances = max((int64) 1, args.get_option_int64("--sketch-instances"));
+    sketch_size = max((int64) 2, args.get_option_int64("--sketch-k"));
+    if (args.get_option_string("--estimator").find("sketch") != string::npos)
+        cout << "sketch estimator set to " << sketch_instances << " instances, k = " << sketch_size << endl;
+    evaluator = args.get_option_string("--evaluator");
+    if (evaluator != "rr" && evaluator != "fi" && evaluator != "mc" && evaluator != "sketch") {
+        std::cerr << "(get error) unknown evaluator: " << evaluator << std::endl;
+        std::exit(-1);
+    }
+    eval_RR_sets = max((int64) 1, args.get_option_int64("--eval-sets"));
+    cout << "seed quality evaluator set to " << evaluator;
+    if (evaluator == "rr") cout << ", RI sets = " << eval_RR_sets;
+    cout << endl;
+    sweep_jobs = (int32) max((int64) 1, args.get_option_int64("--jobs"));
+    sweep_memory_limit = max((int64) 0, args.get_option_int64("--memory-limit"));
+    if (sweep_jobs > 1 || sweep_memory_limit > 0)
+        cout << "experiment jobs set to " << sweep_jobs << ", memory limit = " << sweep_memory_limit << " MB" << endl;
+    if (!args.get_option_string("--checkpoint").empty()) {
+        checkpoint_dir = "../output/" + args.get_option_string("--checkpoint");
+        cout << "checkpoint directory set to " << checkpoint_dir << endl;
+    }
+    if (sscanf(args.get_option_string("--shard").c_str(), "%d/%d", &shard_id, &shard_count) != 2 ||
+        shard_count < 1 || shard_id < 0 || shard_id >= shard_count) {
+        std::cerr << "(get error) bad shard: " << args.get_option_string("--shard") << std::endl;
+        std::exit(-1);
+    }
+    if (shard_count > 1) {
+        if (checkpoint_dir.empty()) {
+            std::cerr << "(get error) --shard needs --checkpoint" << std::endl;
+            std::exit(-1);
+        }
+        cout << "shard set to " << shard_id << " / " << shard_count << endl;
+    }
+    time_budget = args.get_option_double("--budget");
+    if (time_budget > 0) cout << "IMM time budget set to " << time_budget << "s\n";
 }
 
 double solvers(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds, IM_solver solver) {
-    double cur = clock();
+    double cur = wall_clock();
     seeds.clear();
+    Context &c = ctx();
+    std::ostream &log = *c.log;
+    char buf[64];
+    c.spread_estimator = solver_estimator[solver];
     switch (solver) {
         case ENUMERATION:
             enumeration_method(graph, k, A, seeds);
@@ -82,88 +260,80 @@ double solvers(Graph &graph, int32 k, vector<node> &A, vector<node> &seeds, IM_s
             //print_set_f(seeds, " Seed set using ADVANCED CELF: ");
             break;
         case IMM_NORMAL:
+            if (time_budget > 0) {
+                anytime_IMM_method(graph, k, A, seeds);
+                print_set(seeds, " Seed set using IMM: ");
+                snprintf(buf, sizeof(buf), " certified ratio = %.4f RR sets = %ld", c.OPIM_ratio,
+                         (long) c.anytime_RR_used);
+                log << buf;
+                break;
+            }
             IMM_method(graph, k, A, seeds);
             print_set(seeds, " Seed set using IMM: ");
             //print_set_f(seeds, " Seed set using IMM: ");
             break;
         case IMM_ADVANCED:
+            if (time_budget > 0) {
+                anytime_advanced_IMM_method(graph, k, A, seeds);
+                print_set(seeds, " Seed set using ADVANCED IMM: ");
+                snprintf(buf, sizeof(buf), " certified ratio = %.4f RR sets = %ld", c.OPIM_ratio,
+                         (long) c.anytime_RR_used);
+                log << buf;
+                break;
+            }
             advanced_IMM_method(graph, k, A, seeds);
             print_set(seeds, " Seed set using ADVANCED IMM: ");
             //print_set_f(seeds, " Seed set using ADVANCED IMM: ");
             break;
+        case OPIM_NORMAL:
+            OPIM_method(graph, k, A, seeds);
+            print_set(seeds, " Seed set using OPIM-C: ");
+            snprintf(buf, sizeof(buf), " certified ratio = %.4f", c.OPIM_ratio);
+            log << buf;
+            //print_set_f(seeds, " Seed set using OPIM-C: ");
+            break;
+        case LOCAL_PPR:
+            local_ppr_method(graph, k, A, seeds);
+            print_set(seeds, " Seed set using local PPR: ");
+            break;
         default:
             break;
     }
-    if (verbose_flag) printf(" total time = %.3f\n", time_by(cur));
-    else puts("");
-    out << '\n';
-    return time_by(cur);
+    double time = time_by(cur);
+    if (verbose_flag) snprintf(buf, sizeof(buf), " total time = %.3f", time), log << buf;
+    log << endl;
+    *c.out << '\n';
+    profile_record(c.profile, solver_name[solver], k, (int64) A.size(), time);
+    return time;
 }
 
-void Run_simulation(vector<node> &A_batch, vector<int32> &k_batch, vector<IM_solver> &solver_batch, model_type type,
-                    int32 rounds = 3) {
-    fstream file_eraser("../output/result.out", ios::out);
-    file_eraser.close();
-    out.open("../output/result.out", ios::app);
-    //load graph from absolute path
-    Graph G(graphFilePath, DIRECTED_G);
-
-    //set diffusion model
-    G.set_diffusion_model(type, 15);
-
-    //Instantiate the active participant set A and seed set
-    vector<node> A, seeds;
-
-    double result[12][500], timer[12][500], seedSize[12][500];
-
-    string solver_name[] = {"ENUMERATION", "DEGREE", "PAGERANK", "CELF", "DEGREE_ADVANCED", "PAGERANK_ADVANCED",
-                            "CELF_ADVANCED", "IMM_NORMAL", "IMM_ADVANCED"};
-
-
-    for (node A_size : A_batch) {
-        double overlap_ratio = 0;
-        memset(result, 0, sizeof(result));
-        memset(timer, 0, sizeof(timer));
-        for (int32 r_ = 1; r_ <= rounds; r_++) {
-            generate_seed(G, A, A_size);
-            print_set(A, "active participant: "), puts("");
-            print_set_f(A, "active participant: "), out << '\n';
-            overlap_ratio += estimate_neighbor_overlap(G, A) / rounds;
-            for (int32 k : k_batch) {
-                cout << "Working on A_size = " << A_size << ", round = " << r_ << ", k = " << k << endl;
-                out << "Working on A_size = " << A_size << ", round = " << r_ << ", k = " << k << endl;
-                for (IM_solver solver_used : solver_batch) {
-                    timer[solver_used][k] += solvers(G, k, A, seeds, solver_used) / rounds;
-                    result[solver_used][k] += FI_simulation(G, seeds) / rounds;
-                    seedSize[solver_used][k] += (double) seeds.size() / rounds;
-                }
-            }
-        }
-        cout << "\"*************\\nSize " << A_size << " DONE!\n*************\n";
+/*!
+ * @brief Run a solver in the given context. Different contexts can run solvers on the same graph concurrently.
+ * @param context : the solver context
+ * @return : the running time
+ */
+double solvers(Context &context, Graph &graph, int32 k, vector<node> &A, vector<node> &seeds, IM_solver solver) {
+    context_scope scope(context);
+    return solvers(graph, k, A, seeds, solver);
+}
 
-        cout << "Active participant size = " << A_size << endl;
-        cout << "Mean overlap ratio = " << overlap_ratio << endl;
-        for (int32 k : k_batch) {
-            cout << "\tk = " << k << endl;
-            for (IM_solver solver_used : solver_batch) {
-                cout << "\t\tseed quality of " << solver_name[solver_used] << " = " << result[solver_used][k];
-                cout << " time = " << timer[solver_used][k];
-                cout << " size = " << seedSize[solver_used][k] << endl;
-            }
-        }
+/*!
+ * @brief Evaluate the quality of a seed set with the backend chosen by --evaluator.
+ */
+double evaluate_seeds(Graph &graph, vector<node> &seeds) {
+    if (evaluator == "rr") return rr_evaluator_of(graph).evaluate(vector<vector<node>>(1, seeds))[0].value;
+    if (evaluator == "sketch") return sketches_of(graph)->spread(seeds);
+    if (evaluator == "mc") return MC_simulation(graph, seeds);
+    return FI_simulation(graph, seeds);
+}
 
-        out << "Active participant size = " << A_size << endl;
-        out << "Mean overlap ratio = " << overlap_ratio << endl;
-        for (int32 k : k_batch) {
-            out << "\tk = " << k << endl;
-            for (IM_solver solver_used : solver_batch) {
-                out << "\t\tseed quality of " << solver_name[solver_used] << " = " << result[solver_used][k];
-                out << " time = " << timer[solver_used][k];
-                out << " size = " << seedSize[solver_used][k] << endl;
-            }
-        }
-    }
-    out.close();
+/*!
+ * @brief --precompute-mg0 mode : compute the single-node spreads of the graph with the given diffusion model.
+ */
+void Precompute_MG0(model_type type) {
+    Graph G(graphFilePath, DIRECTED_G);
+    G.set_diffusion_model(type, 15);
+    precompute_MG0(G, MG0_output_path, MG0_estimator);
 }
 
 #endif //EXP_TOP_H
@@ -0,0 +1,70 @@
+// Batched edge updates that keep the RI sets of the solvers up to date
+
+#ifndef EXP_UPDATE_H
+#define EXP_UPDATE_H
+
+#include "OPIM.h"
+#include "rreval.h"
+
+/*!
+ * @brief What an update has changed.
+ *
+ * dirty : number of nodes whose in-edges have changed
+ * resampled : number of RI sets sampled again, over R, R1, R2 and the evaluation pool
+ * kept : number of RI sets that are still valid
+ */
+struct update_report {
+    int64 inserted = 0, deleted = 0, dirty = 0, resampled = 0, kept = 0;
+    double time = 0;
+};
+
+/*!
+ * @brief Apply a batch of edge deletions and insertions to the graph and keep the RI sets that live between
+ * queries valid, see Graph::update_edges and refresh_RR_sets.
+ *
+ * R of IMM, R1 and R2 of OPIM of every solver context and the evaluation pool only sample again the sets that
+ * contain a dirty node. If the update adds new nodes, the roots of all sets would have to be drawn again, so they
+ * are emptied instead. No context may be solving a query meanwhile.
+ * Every other structure built on the graph (pagerank, sketches, snapshots, bounds, participant index) checks
+ * Graph::version and is built again at its next use.
+ * @param graph : the graph
+ * @param insertions : the edges to insert
+ * @param deletions : the edges to delete
+ * @return : the report
+ */
+update_report update_graph(Graph &graph, const vector<pair<node, node>> &insertions,
+                           const vector<pair<node, node>> &deletions) {
+    update_report res;
+    double cur = wall_clock();
+    node n = graph.n;
+    bool eval_ready = rr_evaluator.built_for(graph, eval_RR_sets);
+    vector<node> dirty;
+    res.deleted = graph.update_edges(insertions, deletions, dirty);
+    res.inserted = (int64) insertions.size();
+    res.dirty = (int64) dirty.size();
+    if (graph.n != n) {
+        Context::for_each([&](Context &c) { c.fit(graph); });
+    } else {
+        Context::for_each([&](Context &c) {
+            for (RRcollection *R : {&c.R, &c.R1_opim, &c.R2_opim}) {
+                if (R->covered.size() != graph.n) continue;
+                res.resampled += refresh_RR_sets(graph, R->sets, R->states, R->covered, R->coveredNum, dirty);
+                res.kept += (int64) R->sets.size();
+            }
+        });
+        if (eval_ready) {
+            res.resampled += rr_evaluator.refresh(graph, dirty);
+            res.kept += rr_evaluator.size();
+        }
+        res.kept -= res.resampled;
+    }
+    res.time = time_by(cur);
+    if (verbose_flag) {
+        printf("\tgraph updated. inserted = %ld, deleted = %ld, dirty nodes = %ld, RI sets sampled again = %ld, "
+               "kept = %ld, time = %.3f\n", (long) res.inserted, (long) res.deleted, (long) res.dirty,
+               (long) res.resampled, (long) res.kept, res.time);
+    }
+    return res;
+}
+
+#endif //EXP_UPDATE_H
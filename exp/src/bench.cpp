@@ -0,0 +1,270 @@
+// Microbenchmarks of the kernels on bundled and synthetic graphs, one JSON record per kernel and graph
+
+#include "top.h"
+#include <cstdio>
+#include <functional>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/*!
+ * @brief A graph of the benchmarks : a file of the data folder or a synthetic graph written to a temporary file.
+ */
+struct bench_graph {
+    string name, path;
+    bool temporary;
+};
+
+/*!
+ * @brief Write a synthetic graph with a fixed seed.
+ * @param kind : er for uniform random edges, pl for a power-law in-degree (half of the targets are copied from
+ * an earlier edge, so a node is chosen in proportion to its in-degree)
+ * @param n : number of nodes
+ * @param m : number of edges
+ * @param seed : the seed of the generator
+ * @param path : the file to write
+ */
+void write_synthetic(const string &kind, node n, int64 m, uint32_t seed, const string &path) {
+    std::mt19937 engine(seed);
+    std::uniform_int_distribution<node> any(0, n - 1);
+    vector<node> targets;
+    FILE *f = fopen(path.c_str(), "w");
+    if (f == nullptr) {
+        std::cerr << "(get error) cannot write synthetic graph: " << path << std::endl;
+        std::exit(-1);
+    }
+    for (int64 i = 0; i < m; i++) {
+        node u = any(engine), v = any(engine);
+        if (kind == "pl" && !targets.empty() && engine() % 2 == 0)
+            v = targets[std::uniform_int_distribution<int64>(0, (int64) targets.size() - 1)(engine)];
+        if (u == v) v = (v + 1) % n;
+        targets.emplace_back(v);
+        fprintf(f, "%d,%d\n", (int) u, (int) v);
+    }
+    fclose(f);
+}
+
+/*!
+ * @brief Reset the peak resident memory of the process, false if the kernel does not support it.
+ */
+bool reset_peak_memory() {
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f == nullptr) return false;
+    bool ok = fputs("5", f) >= 0;
+    return fclose(f) == 0 && ok;
+}
+
+/*!
+ * @brief The peak resident memory of the process in bytes, since the last reset_peak_memory if it has worked.
+ */
+int64 peak_memory() {
+    FILE *f = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = -1;
+    while (f != nullptr && fgets(line, sizeof(line), f))
+        if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+    if (f != nullptr) fclose(f);
+    if (kb < 0) {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        kb = usage.ru_maxrss;
+    }
+    return (int64) kb << 10;
+}
+
+/*!
+ * @brief Runs the kernels and writes their records.
+ *
+ * Every kernel starts from the same seed : the random streams of the current context and of the calling thread
+ * are seeded again before it, so a run with one thread is repeated exactly. An operation runs once to warm up and
+ * then in doubling batches until min_time has passed. The record is
+ * {"kernel":"RI_Gen_reverse","graph":"er_20000_100000","n":20000,"m":100000,"seed":1,"ops":...,"ns_per_op":...,
+ * "items_per_op":...,"items_per_sec":...,"peak_memory":...}, where the items are the unit of work of the kernel,
+ * e.g. the edges of Graph::open and the nodes of the RI sets of RI_Gen, and peak_memory is the peak resident
+ * memory of the process during the kernel in bytes (since the start of the process if the kernel cannot reset it).
+ */
+class BenchRunner {
+public:
+    BenchRunner(uint32_t seed, double min_time, const string &filter, std::ostream &os)
+            : seed(seed), min_time(min_time), filter(filter), os(os) {}
+
+    void run(const bench_graph &bg) {
+        Graph G;
+        G.open(bg.path, DIRECTED_G);
+        G.set_diffusion_model(IC_M, 15);
+        std::mt19937 engine;
+        auto reseed = [&]() {
+            engine.seed(seed);
+            ctx().engine.seed(seed);
+            thread_workspace().engine.seed(seed);
+            thread_MC_state().engine.seed(seed);
+        };
+        reseed();
+        vector<node> S = random_set(G, engine, min((node) 50, G.n));
+        vector<node> A = random_set(G, engine, max((node) 1, min((node) 1000, G.n / 10)));
+        vector<node> all(G.n), RR;
+        for (node i = 0; i < G.n; i++) all[i] = i;
+        std::uniform_int_distribution<node> any(0, G.n - 1);
+
+        measure(bg, G, "Graph::open", reseed, [&]() {
+            Graph H;
+            H.open(bg.path, DIRECTED_G);
+            return (double) H.m;
+        });
+        measure(bg, G, "set_diffusion_model", reseed, [&]() {
+            G.set_diffusion_model(IC_M, 15);
+            return (double) G.m;
+        });
+        measure(bg, G, "RI_Gen_reverse", reseed, [&]() {
+            vector<node> uStart(1, any(engine));
+            RI_Gen(G, uStart, RR, true);
+            return (double) RR.size();
+        });
+        measure(bg, G, "RI_Gen_forward", reseed, [&]() {
+            RI_Gen(G, S, RR, false);
+            return (double) RR.size();
+        });
+        init_R(G.n);
+        measure(bg, G, "insert_R", reseed, [&]() {
+            insert_R(G);
+            return 1.0;
+        });
+        init_R(G.n);
+        measure(bg, G, "IMMNodeSelection", [&]() {
+            reseed();
+            init_R(G.n);
+            fill_R(G, bench_RR_sets);
+        }, [&]() {
+            vector<node> seeds;
+            IMMNodeSelection(G, all, (int32) S.size(), seeds);
+            return (double) ctx().R.sets.size();
+        });
+        init_R(G.n);
+        for (model_type type : {IC, IC_M}) {
+            G.set_diffusion_model(type, 15);
+            measure(bg, G, type == IC ? "MC_simulation_IC" : "MC_simulation_IC_M", reseed, [&]() {
+                MC_simulation(G, S);
+                return (double) MC_iteration_rounds;
+            });
+        }
+        measure(bg, G, "power_iteration", reseed, [&]() {
+            vector<double> pi;
+            return (double) power_iteration(G, pi, 0.2) * G.m;
+        });
+        ParticipantIndex index;
+        measure(bg, G, "source_participant", [&]() {
+            reseed();
+            index.build(G, A);
+        }, [&]() {
+            ParticipantQuota quota(index, (int32) S.size());
+            for (node v : index.candidates) sink += quota.source(v);
+            return (double) index.candidates.size();
+        });
+    }
+
+    ///number of RI sets in R for IMMNodeSelection
+    int64 bench_RR_sets = 10000;
+
+private:
+    uint32_t seed;
+    double min_time;
+    string filter;
+    std::ostream &os;
+    ///keeps the results of the kernels that return nothing else alive
+    volatile int64 sink = 0;
+
+    static vector<node> random_set(Graph &G, std::mt19937 &engine, node size) {
+        vector<node> nodes(G.n);
+        for (node i = 0; i < G.n; i++) nodes[i] = i;
+        shuffle(nodes.begin(), nodes.end(), engine);
+        nodes.resize(size);
+        return nodes;
+    }
+
+    /*!
+     * @param setup : runs before the kernel, not timed
+     * @param op : runs one operation and returns the number of items it has processed
+     */
+    void measure(const bench_graph &bg, Graph &G, const string &kernel, const std::function<void()> &setup,
+                 const std::function<double()> &op) {
+        if (!filter.empty() && kernel.find(filter) == string::npos) return;
+        setup();
+        reset_peak_memory();
+        op();
+        int64 ops = 0;
+        double items = 0, elapsed = 0;
+        for (int64 batch = 1; elapsed < min_time; batch *= 2) {
+            double cur = wall_clock();
+            for (int64 i = 0; i < batch; i++) items += op();
+            elapsed += time_by(cur);
+            ops += batch;
+        }
+        char buf[256];
+        snprintf(buf, sizeof(buf), ",\"ops\":%lld,\"ns_per_op\":%.6g,\"items_per_op\":%.6g,\"items_per_sec\":%.6g",
+                 (long long) ops, elapsed * 1e9 / ops, items / ops, items / max(elapsed, 1e-12));
+        os << "{\"kernel\":\"" << kernel << "\",\"graph\":\"" << bg.name << "\",\"n\":" << G.n << ",\"m\":" << G.m
+           << ",\"seed\":" << seed << buf << ",\"peak_memory\":" << peak_memory() << "}" << endl;
+    }
+};
+
+vector<string> split_list(const string &s) {
+    vector<string> items;
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, ','))
+        if (!item.empty()) items.emplace_back(item);
+    return items;
+}
+
+int main(int argc, char const *argv[]) {
+    auto args = util::argparser("Microbenchmarks of the kernels of BIM.");
+    args.set_program_name("bench")
+            .add_help_option()
+            .add_option<std::string>("-g", "--graphs", "comma-separated graph files of the data folder, default is test.csv", "test.csv")
+            .add_option<std::string>("", "--synthetic", "comma-separated synthetic graphs as kind:n:m, kind is er (uniform) or pl (power-law in-degree), default is er:20000:100000,pl:20000:100000", "er:20000:100000,pl:20000:100000")
+            .add_option<int64>("-s", "--seed", "seed of the synthetic graphs and of the random streams, default is 1", 1)
+            .add_option<double>("", "--min-time", "minimum running time of each kernel in seconds, default is 0.5", 0.5)
+            .add_option<std::string>("-f", "--filter", "only run the kernels whose names contain this string", "")
+            .add_option<int64>("-r", "--rounds", "number of MC simulation rounds per operation, default is 1000", 1000)
+            .add_option<int64>("", "--rr-sets", "number of RI sets of IMMNodeSelection, default is 10000", 10000)
+            .add_option<int64>("-t", "--threads", "number of threads of the parallel kernels, default is 1", 1)
+            .add_option<std::string>("-o", "--output", "write the records to this file of the output folder instead of stdout", "")
+            .parse(argc, argv);
+    auto seed = (uint32_t) args.get_option_int64("--seed");
+    MC_iteration_rounds = args.get_option_int64("--rounds");
+    num_threads = (int32) max((int64) 1, args.get_option_int64("--threads"));
+    ofstream file;
+    if (!args.get_option_string("--output").empty()) {
+        string path = "../output/" + args.get_option_string("--output");
+        file.open(path, ios::out);
+        if (!file.is_open()) {
+            std::cerr << "(get error) cannot write benchmark records: " << path << std::endl;
+            std::exit(-1);
+        }
+    }
+    vector<bench_graph> graphs;
+    for (auto &name : split_list(args.get_option_string("--graphs")))
+        graphs.emplace_back(bench_graph{name, "../data/" + name, false});
+    for (auto &spec : split_list(args.get_option_string("--synthetic"))) {
+        char kind[8];
+        long long n, m;
+        if (sscanf(spec.c_str(), "%7[a-z]:%lld:%lld", kind, &n, &m) != 3 || (string(kind) != "er" &&
+                                                                              string(kind) != "pl") || n < 2 || m < 1) {
+            std::cerr << "(get error) bad synthetic graph: " << spec << std::endl;
+            std::exit(-1);
+        }
+        string name = string(kind) + "_" + to_string(n) + "_" + to_string(m);
+        string path = string(P_tmpdir) + "/bench_" + name + "_" + to_string(getpid()) + ".csv";
+        write_synthetic(kind, (node) n, m, seed, path);
+        graphs.emplace_back(bench_graph{name, path, true});
+    }
+    Context context(num_threads);
+    context_scope scope(context);
+    BenchRunner runner(seed, args.get_option_double("--min-time"), args.get_option_string("--filter"),
+                       file.is_open() ? (std::ostream &) file : cout);
+    runner.bench_RR_sets = args.get_option_int64("--rr-sets");
+    for (auto &bg : graphs) {
+        runner.run(bg);
+        if (bg.temporary) remove(bg.path.c_str());
+    }
+    return 0;
+}
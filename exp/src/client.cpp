@@ -0,0 +1,51 @@
+// A small client of the query server : sends the request lines of stdin and prints the replies
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+int main(int argc, char const *argv[]) {
+    if (argc != 2) {
+        cerr << "usage: client <socket path> < requests" << endl;
+        return 1;
+    }
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr *) &addr, sizeof(addr)) != 0) {
+        cerr << "(get error) cannot connect to " << argv[1] << endl;
+        return 1;
+    }
+    //one request line, then wait for its reply line
+    string line, buf;
+    char chunk[4096];
+    while (getline(cin, line)) {
+        if (line.empty()) continue;
+        line += '\n';
+        if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != (ssize_t) line.size()) {
+            cerr << "(get error) connection closed" << endl;
+            return 1;
+        }
+        size_t pos;
+        while ((pos = buf.find('\n')) == string::npos) {
+            ssize_t got = read(fd, chunk, sizeof(chunk));
+            if (got <= 0) {
+                cerr << "(get error) connection closed" << endl;
+                return 1;
+            }
+            buf.append(chunk, got);
+        }
+        cout << buf.substr(0, pos) << endl;
+        buf.erase(0, pos + 1);
+    }
+    close(fd);
+    return 0;
+}
@@ -1,7 +1,20 @@
-#include "top.h"
+#include "batch.h"
+#include "schedule.h"
 
 int main(int argc, char const *argv[]) {
     init_commandLine(argc, argv);
+    if (!MG0_output_path.empty()) {
+        Precompute_MG0(IC_M);
+        return 0;
+    }
+    if (!batch_path.empty()) {
+        Batch(IC_M);
+        return 0;
+    }
+    if (!serve_path.empty()) {
+        Serve(IC_M);
+        return 0;
+    }
     vector<node> A_batch = {1000, 2000, 5000};
     vector<int32> k_batch = {10};
     vector<IM_solver> solver_batch = {DEGREE, PAGERANK, IMM_NORMAL, DEGREE_ADVANCED, PAGERANK_ADVANCED, IMM_ADVANCED};